@@ -0,0 +1,330 @@
+#include <lunasvg.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace lunasvg;
+
+static std::string generateIcon(int shapeCount)
+{
+    std::string content = "<svg xmlns='http://www.w3.org/2000/svg' width='256' height='256' viewBox='0 0 256 256'>";
+    content += "<defs><linearGradient id='g'><stop offset='0' stop-color='#1565c0'/><stop offset='1' stop-color='#80deea'/></linearGradient></defs>";
+    content += "<rect width='256' height='256' rx='32' fill='url(#g)'/>";
+    for(int i = 0; i < shapeCount; ++i) {
+        auto x = (i * 37) % 256;
+        auto y = (i * 91) % 256;
+        content += "<circle cx='" + std::to_string(x) + "' cy='" + std::to_string(y) + "' r='" + std::to_string(4 + i % 24) + "' fill='#ffffff' fill-opacity='0.4'/>";
+    }
+
+    content += "</svg>";
+    return content;
+}
+
+struct BenchmarkCase {
+    const char* name;
+    std::string content;
+    std::string styleSheet;
+};
+
+static std::string number(int value)
+{
+    return std::to_string(value);
+}
+
+static std::string openDocument()
+{
+    return "<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink' width='512' height='512' viewBox='0 0 512 512'>";
+}
+
+static BenchmarkCase generateDeepGroups(int depth)
+{
+    auto content = openDocument();
+    for(int i = 0; i < depth; ++i)
+        content += "<g transform='translate(0.25 0.25) rotate(0.1)' opacity='" + std::string(i % 8 == 0 ? "0.99" : "1") + "'>";
+    content += "<rect width='256' height='256' fill='#3f51b5'/>";
+    for(int i = 0; i < depth; ++i)
+        content += "</g>";
+    content += "</svg>";
+    return {"deep-groups", content, std::string()};
+}
+
+static BenchmarkCase generateManyPaths(int pathCount)
+{
+    auto content = openDocument();
+    for(int i = 0; i < pathCount; ++i) {
+        auto x = (i * 37) % 512;
+        auto y = (i * 91) % 512;
+        content += "<path d='M" + number(x) + " " + number(y) + "c10 -20 30 -20 40 0s30 20 40 0l-20 40z' fill='#" + (i % 2 ? "e91e63" : "009688") + "' stroke='#000' stroke-width='0.5'/>";
+    }
+
+    content += "</svg>";
+    return {"many-paths", content, std::string()};
+}
+
+static BenchmarkCase generateHugeStyleSheet(int ruleCount, int elementCount)
+{
+    std::string styleSheet;
+    for(int i = 0; i < ruleCount; ++i) {
+        styleSheet += ".c" + number(i) + " { fill: #" + (i % 2 ? "ff9800" : "607d8b") + "; stroke-width: " + number(1 + i % 4) + " }\n";
+        styleSheet += "g > rect.c" + number(i) + ":first-child { stroke: #000 }\n";
+    }
+
+    auto content = openDocument();
+    content += "<style>" + styleSheet + "</style><g>";
+    for(int i = 0; i < elementCount; ++i) {
+        content += "<rect class='c" + number(i % ruleCount) + "' x='" + number((i * 13) % 512) + "' y='" + number((i * 29) % 512) + "' width='16' height='16'/>";
+    }
+
+    content += "</g></svg>";
+    return {"huge-stylesheet", content, styleSheet};
+}
+
+static BenchmarkCase generateGradients(int gradientCount)
+{
+    auto content = openDocument();
+    content += "<defs>";
+    for(int i = 0; i < gradientCount; ++i) {
+        if(i % 2 == 0) {
+            content += "<linearGradient id='g" + number(i) + "' x2='0' y2='1' gradientTransform='rotate(" + number(i % 90) + ")'>";
+            content += "<stop offset='0' stop-color='#2196f3'/><stop offset='0.5' stop-color='#ffeb3b' stop-opacity='0.5'/><stop offset='1' stop-color='#f44336'/></linearGradient>";
+        } else {
+            content += "<radialGradient id='g" + number(i) + "' xlink:href='#g" + number(i - 1) + "' fx='0.3' fy='0.3'/>";
+        }
+    }
+
+    content += "</defs>";
+    for(int i = 0; i < gradientCount; ++i) {
+        content += "<circle cx='" + number((i * 37) % 512) + "' cy='" + number((i * 91) % 512) + "' r='" + number(8 + i % 32) + "' fill='url(#g" + number(i) + ")'/>";
+    }
+
+    content += "</svg>";
+    return {"gradients", content, std::string()};
+}
+
+static BenchmarkCase generateMasks(int maskCount)
+{
+    auto content = openDocument();
+    content += "<defs><clipPath id='clip'><circle cx='256' cy='256' r='240'/></clipPath></defs>";
+    for(int i = 0; i < maskCount; ++i) {
+        auto x = (i * 37) % 448;
+        auto y = (i * 91) % 448;
+        content += "<mask id='m" + number(i) + "'><rect x='" + number(x) + "' y='" + number(y) + "' width='64' height='64' fill='#fff' fill-opacity='0.5'/></mask>";
+        content += "<g mask='url(#m" + number(i) + ")' clip-path='url(#clip)'><rect x='" + number(x) + "' y='" + number(y) + "' width='64' height='64' fill='#8bc34a'/></g>";
+    }
+
+    content += "</svg>";
+    return {"masks", content, std::string()};
+}
+
+static BenchmarkCase generateText(int lineCount)
+{
+    auto content = openDocument();
+    for(int i = 0; i < lineCount; ++i) {
+        content += "<text x='8' y='" + number(12 + (i * 14) % 500) + "' font-family='sans-serif' font-size='12'>Line " + number(i);
+        content += " <tspan font-weight='bold' fill='#d32f2f'>quick brown fox</tspan> jumps over the lazy dog</text>";
+    }
+
+    content += "</svg>";
+    return {"text", content, std::string()};
+}
+
+static BenchmarkCase generateUses(int useCount)
+{
+    auto content = openDocument();
+    content += "<defs><g id='shape'><rect width='24' height='24' rx='4' fill='#795548'/><circle cx='12' cy='12' r='6' fill='#ffc107'/></g>";
+    content += "<g id='pair'><use xlink:href='#shape'/><use xlink:href='#shape' x='28'/></g></defs>";
+    for(int i = 0; i < useCount; ++i) {
+        content += "<use xlink:href='#pair' x='" + number((i * 37) % 460) + "' y='" + number((i * 91) % 488) + "'/>";
+    }
+
+    content += "</svg>";
+    return {"uses", content, std::string()};
+}
+
+static BenchmarkCase generateSiblings(int siblingCount)
+{
+    std::string styleSheet;
+    styleSheet += "rect + circle { fill: #3f51b5 }\n";
+    styleSheet += "circle ~ rect { stroke: #000 }\n";
+    styleSheet += "rect:first-of-type, circle:last-of-type { stroke-width: 4 }\n";
+    styleSheet += "g > :last-child { fill: #ff5722 }\n";
+
+    auto content = openDocument();
+    content += "<style>" + styleSheet + "</style><g>";
+    for(int i = 0; i < siblingCount; ++i) {
+        auto x = number((i * 13) % 512);
+        auto y = number((i * 29) % 512);
+        if(i % 3 == 0) {
+            content += "<circle cx='" + x + "' cy='" + y + "' r='6'/>";
+        } else {
+            content += "<rect x='" + x + "' y='" + y + "' width='12' height='12'/>";
+        }
+    }
+
+    content += "</g></svg>";
+    return {"siblings", content, styleSheet};
+}
+
+static std::vector<BenchmarkCase> generateCorpus(int scale)
+{
+    std::vector<BenchmarkCase> corpus;
+    corpus.push_back(generateDeepGroups(100 * scale));
+    corpus.push_back(generateManyPaths(2000 * scale));
+    corpus.push_back(generateHugeStyleSheet(500 * scale, 2000 * scale));
+    corpus.push_back(generateGradients(200 * scale));
+    corpus.push_back(generateMasks(50 * scale));
+    corpus.push_back(generateText(200 * scale));
+    corpus.push_back(generateUses(500 * scale));
+    corpus.push_back(generateSiblings(10000 * scale));
+    return corpus;
+}
+
+static std::string generateWideTree(int groupCount)
+{
+    auto content = openDocument();
+    for(int i = 0; i < groupCount; ++i) {
+        content += "<g id='g" + number(i) + "' class='c" + number(i % 100) + "'>";
+        for(int j = 0; j < 9; ++j)
+            content += "<rect x='" + number(j) + "' width='1' height='1'/>";
+        content += "</g>";
+    }
+
+    content += "</svg>";
+    return content;
+}
+
+static size_t countChildren(const Element& element)
+{
+    size_t count = 1;
+    for(const auto& child : element.children()) {
+        if(child.isElement()) {
+            count += countChildren(child.toElement());
+        } else {
+            count += 1;
+        }
+    }
+
+    return count;
+}
+
+static size_t countChildNodes(const Element& element)
+{
+    size_t count = 1;
+    for(const auto& child : element.childNodes()) {
+        if(child.isElement()) {
+            count += countChildNodes(child.toElement());
+        } else {
+            count += 1;
+        }
+    }
+
+    return count;
+}
+
+static void countBytes(void* closure, void*, int size)
+{
+    *static_cast<size_t*>(closure) += size;
+}
+
+template<typename Function>
+static double measure(int iterations, Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i)
+        function();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    int size = argc > 1 ? std::atoi(argv[1]) : 1024;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+    int scale = argc > 3 ? std::atoi(argv[3]) : 1;
+
+    std::printf("[\n");
+    for(const auto& benchmark : generateCorpus(scale)) {
+        DocumentStatistics load;
+        std::unique_ptr<Document> document;
+        for(int i = 0; i < iterations; ++i) {
+            document = Document::loadFromData(benchmark.content);
+            if(document == nullptr)
+                return 1;
+            auto statistics = document->statistics();
+            load.tokenizeTime += statistics.tokenizeTime / iterations;
+            load.cascadeTime += statistics.cascadeTime / iterations;
+            load.buildTime += statistics.buildTime / iterations;
+        }
+
+        document->setStatisticsEnabled(true);
+        for(int i = 0; i < iterations; ++i)
+            document->updateLayout();
+        Bitmap bitmap(size, size);
+        for(int i = 0; i < iterations; ++i) {
+            bitmap.clear(0);
+            document->render(bitmap, Matrix::scaled(size / document->width(), size / document->height()));
+        }
+
+        auto statistics = document->statistics();
+        std::printf("  {\"case\": \"%s\", \"bytes\": %zu, \"tokenize\": %.3f, \"cascade\": %.3f, \"build\": %.3f, \"layout\": %.3f, \"render\": %.3f, ",
+            benchmark.name, benchmark.content.size(), load.tokenizeTime, load.cascadeTime, load.buildTime,
+            statistics.layoutTime / iterations, statistics.renderTime / iterations);
+        std::printf("\"elements\": %llu, \"attributes\": %llu, \"rulesTested\": %llu, \"rulesMatched\": %llu, \"layers\": %llu, \"layerPixels\": %llu, \"masks\": %llu, \"clipMasks\": %llu, \"glyphs\": %llu},\n",
+            (unsigned long long)statistics.elementsCreated, (unsigned long long)statistics.attributesSet,
+            (unsigned long long)statistics.rulesTested, (unsigned long long)statistics.rulesMatched,
+            (unsigned long long)(statistics.layersAllocated / iterations), (unsigned long long)(statistics.layerPixels / iterations),
+            (unsigned long long)(statistics.maskRenders / iterations), (unsigned long long)(statistics.clipMaskRenders / iterations),
+            (unsigned long long)(statistics.glyphsDrawn / iterations));
+    }
+
+    auto document = Document::loadFromData(generateIcon(200));
+    if(document == nullptr)
+        return 1;
+    auto bitmap = document->renderToBitmap(size, size);
+
+    size_t bytes = 0;
+    auto elapsed = measure(iterations, [&] { bytes = 0; bitmap.writeToPng(countBytes, &bytes); });
+    std::printf("  {\"encoder\": \"plutovg\", \"ms\": %.3f, \"bytes\": %zu}", elapsed, bytes);
+    for(int level : {0, 1, 6, 9}) {
+        for(int threadCount : {1, 4}) {
+            for(bool palette : {false, true}) {
+                PngOptions options;
+                options.compressionLevel = level;
+                options.threadCount = threadCount;
+                options.palette = palette;
+                elapsed = measure(iterations, [&] { bytes = 0; bitmap.writeToPng(countBytes, &bytes, options); });
+                std::printf(",\n  {\"encoder\": \"png\", \"level\": %d, \"threads\": %d, \"palette\": %s, \"ms\": %.3f, \"bytes\": %zu}",
+                    level, threadCount, palette ? "true" : "false", elapsed, bytes);
+            }
+        }
+    }
+
+    elapsed = measure(iterations, [&] { bytes = 0; bitmap.writeToQoi(countBytes, &bytes); });
+    std::printf(",\n  {\"encoder\": \"qoi\", \"ms\": %.3f, \"bytes\": %zu}", elapsed, bytes);
+    elapsed = measure(iterations, [&] { bytes = 0; bitmap.writeToRaw(countBytes, &bytes); });
+    std::printf(",\n  {\"encoder\": \"raw\", \"ms\": %.3f, \"bytes\": %zu}", elapsed, bytes);
+
+    document = Document::loadFromData(generateWideTree(20000 * scale));
+    if(document == nullptr)
+        return 1;
+    size_t nodes = 0;
+    elapsed = measure(iterations, [&] { nodes = countChildren(document->documentElement()); });
+    std::printf(",\n  {\"walk\": \"children\", \"nodes\": %zu, \"ms\": %.3f}", nodes, elapsed);
+    elapsed = measure(iterations, [&] { nodes = countChildNodes(document->documentElement()); });
+    std::printf(",\n  {\"walk\": \"childNodes\", \"nodes\": %zu, \"ms\": %.3f}", nodes, elapsed);
+    elapsed = measure(iterations, [&] { nodes = 0; document->traverse([&](const Node&) { ++nodes; return true; }); });
+    std::printf(",\n  {\"walk\": \"traverse\", \"nodes\": %zu, \"ms\": %.3f}", nodes, elapsed);
+
+    ElementList elements;
+    for(const char* selector : {"#g100", ".c7", "g.c7 > rect:first-child", "rect + rect", "circle, .c7"}) {
+        elapsed = measure(iterations, [&] { elements.clear(); document->querySelectorAll(selector, elements); });
+        std::printf(",\n  {\"query\": \"%s\", \"elements\": %zu, \"ms\": %.3f}", selector, elements.size(), elapsed);
+    }
+
+    std::printf("\n]\n");
+    return 0;
+}
@@ -1,67 +1,328 @@
 #include <lunasvg.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace lunasvg;
 
+namespace fs = std::filesystem;
+
 int help()
 {
     std::cout << "Usage: \n"
-                 "   svg2png [filename] [resolution] [bgColor]\n\n"
+                 "   svg2png [options] [inputs...] [resolution...] [bgColor]\n\n"
+                 "Inputs are SVG files, directories (searched recursively for .svg files) or glob\n"
+                 "patterns such as 'icons/*.svg'. A single '-' reads one input per line from stdin.\n"
+                 "Each resolution renders another PNG per input, named [name]-[width]x[height].png.\n\n"
+                 "Options: \n"
+                 "   -o [directory]           Writes the PNG files into the directory\n"
+                 "   -j [threads]             Renders on the given number of worker threads\n"
+                 "   -f [family] [filename]   Registers a font face for every worker\n\n"
                  "Examples: \n"
                  "    $ svg2png input.svg\n"
                  "    $ svg2png input.svg 512x512\n"
-                 "    $ svg2png input.svg 512x512 0xff00ffff\n\n";
+                 "    $ svg2png input.svg 512x512 0xff00ffff\n"
+                 "    $ svg2png -j 8 -o out icons/ 64x64 128x128\n"
+                 "    $ find . -name '*.svg' | svg2png -o out -\n\n";
     return 1;
 }
 
-bool setup(int argc, char** argv, std::string& filename, std::uint32_t& width, std::uint32_t& height, std::uint32_t& bgColor)
+struct FontFile {
+    std::string family;
+    std::string data;
+};
+
+struct Options {
+    std::vector<std::string> inputs;
+    std::vector<RenderSize> sizes;
+    std::vector<FontFile> fonts;
+    std::string outputDirectory;
+    std::uint32_t bgColor = 0x00000000;
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+};
+
+bool parseSize(const std::string& text, RenderSize& size)
 {
-    if(argc > 1) filename.assign(argv[1]);
-    if(argc > 2) {
-        std::stringstream ss;
-        ss << argv[2];
-        ss >> width;
+    std::uint32_t width = 0, height = 0;
+    std::stringstream ss(text);
+    ss >> width;
+    if(ss.fail() || ss.get() != 'x')
+        return false;
+    ss >> height;
+    if(ss.fail() || ss.peek() != EOF)
+        return false;
+    size = RenderSize(width, height);
+    return true;
+}
 
-        if(ss.fail() || ss.get() != 'x')
+bool parseColor(const std::string& text, std::uint32_t& color)
+{
+    if(text.compare(0, 2, "0x") != 0)
+        return false;
+    std::stringstream ss(text);
+    ss >> std::hex >> color;
+    return !ss.fail() && ss.peek() == EOF;
+}
+
+bool readFile(const std::string& filename, std::string& content)
+{
+    std::ifstream fs(filename, std::ios::binary);
+    if(!fs.is_open())
+        return false;
+    std::ostringstream ss;
+    ss << fs.rdbuf();
+    content = ss.str();
+    return true;
+}
+
+bool setup(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        RenderSize size;
+        if(arg == "-o" && i + 1 < argc) {
+            options.outputDirectory.assign(argv[++i]);
+        } else if(arg == "-j" && i + 1 < argc) {
+            options.threadCount = std::max(1, std::atoi(argv[++i]));
+        } else if(arg == "-f" && i + 2 < argc) {
+            FontFile font;
+            font.family.assign(argv[i + 1]);
+            if(!readFile(argv[i + 2], font.data)) {
+                std::cerr << "Cannot read font file: " << argv[i + 2] << std::endl;
+                return false;
+            }
+
+            options.fonts.push_back(std::move(font));
+            i += 2;
+        } else if(parseSize(arg, size)) {
+            options.sizes.push_back(size);
+        } else if(parseColor(arg, options.bgColor)) {
+            continue;
+        } else if(arg.size() > 1 && arg[0] == '-') {
             return false;
-        ss >> height;
+        } else {
+            options.inputs.push_back(arg);
+        }
     }
 
-    if(argc > 3) {
-        std::stringstream ss;
-        ss << std::hex << argv[3];
-        ss >> std::hex >> bgColor;
-    }
+    if(options.sizes.empty())
+        options.sizes.emplace_back();
+    return !options.inputs.empty();
+}
 
-    return argc > 1;
+bool matchesPattern(const char* pattern, const char* name)
+{
+    if(*pattern == '\0')
+        return *name == '\0';
+    if(*pattern == '*')
+        return matchesPattern(pattern + 1, name) || (*name && matchesPattern(pattern, name + 1));
+    if(*name && (*pattern == '?' || *pattern == *name))
+        return matchesPattern(pattern + 1, name + 1);
+    return false;
 }
 
-int main(int argc, char* argv[])
+bool isSvgFile(const fs::path& path)
 {
-    std::string filename;
-    std::uint32_t width = 0, height = 0;
-    std::uint32_t bgColor = 0x00000000;
-    if(!setup(argc, argv, filename, width, height, bgColor)) {
-        return help();
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".svg";
+}
+
+void expandInput(const std::string& input, std::vector<std::string>& filenames)
+{
+    std::error_code ec;
+    if(input == "-") {
+        std::string line;
+        while(std::getline(std::cin, line)) {
+            if(!line.empty()) {
+                expandInput(line, filenames);
+            }
+        }
+    } else if(fs::is_directory(input, ec)) {
+        std::vector<std::string> entries;
+        for(const auto& entry : fs::recursive_directory_iterator(input, ec)) {
+            if(entry.is_regular_file(ec) && isSvgFile(entry.path())) {
+                entries.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(entries.begin(), entries.end());
+        filenames.insert(filenames.end(), entries.begin(), entries.end());
+    } else if(input.find_first_of("*?") != std::string::npos) {
+        fs::path path(input);
+        auto directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+        auto pattern = path.filename().string();
+        std::vector<std::string> entries;
+        for(const auto& entry : fs::directory_iterator(directory, ec)) {
+            if(entry.is_regular_file(ec) && matchesPattern(pattern.c_str(), entry.path().filename().string().c_str())) {
+                entries.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(entries.begin(), entries.end());
+        filenames.insert(filenames.end(), entries.begin(), entries.end());
+    } else {
+        filenames.push_back(input);
     }
+}
+
+enum Phase {
+    LoadPhase,
+    RenderPhase,
+    EncodePhase,
+    PhaseCount
+};
+
+struct FileResult {
+    bool succeeded = false;
+    double phaseTimes[PhaseCount] = {};
+};
+
+std::string outputFilename(const Options& options, const std::string& filename, const RenderSize& size)
+{
+    auto basename = fs::path(filename).filename().string();
+    if(options.sizes.size() > 1)
+        basename += "-" + std::to_string(size.width) + "x" + std::to_string(size.height);
+    basename.append(".png");
+    if(options.outputDirectory.empty())
+        return basename;
+    return (fs::path(options.outputDirectory) / basename).string();
+}
+
+void convertFile(const Options& options, const std::string& filename, FileResult& result)
+{
+    using Clock = std::chrono::steady_clock;
+    auto elapsed = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
 
+    auto start = Clock::now();
     auto document = Document::loadFromFile(filename);
+    result.phaseTimes[LoadPhase] = elapsed(start);
     if(document == nullptr) {
+        std::cerr << "Cannot load SVG file: " << filename << std::endl;
+        return;
+    }
+
+    for(const auto& size : options.sizes) {
+        start = Clock::now();
+        auto bitmap = document->renderToBitmap(size.width, size.height, options.bgColor);
+        result.phaseTimes[RenderPhase] += elapsed(start);
+        if(bitmap.isNull()) {
+            std::cerr << "Cannot render SVG file: " << filename << std::endl;
+            return;
+        }
+
+        auto outputname = outputFilename(options, filename, size);
+        start = Clock::now();
+        auto written = bitmap.writeToPng(outputname);
+        result.phaseTimes[EncodePhase] += elapsed(start);
+        if(!written) {
+            std::cerr << "Cannot write PNG file: " << outputname << std::endl;
+            return;
+        }
+    }
+
+    result.succeeded = true;
+}
+
+double percentile(std::vector<double>& values, double fraction)
+{
+    if(values.empty())
+        return 0.0;
+    auto index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void printReport(const std::vector<FileResult>& results, size_t imageCount, unsigned threadCount, double seconds)
+{
+    static const char* phaseNames[PhaseCount] = {"load", "render", "encode"};
+    size_t succeeded = std::count_if(results.begin(), results.end(), [](const FileResult& result) { return result.succeeded; });
+    std::printf("Converted %zu of %zu files (%zu PNG files) in %.3f s on %u threads: %.1f files/s\n",
+        succeeded, results.size(), imageCount, seconds, threadCount, succeeded / std::max(seconds, 1e-9));
+    std::printf("%-8s %10s %10s %10s\n", "phase", "p50 ms", "p99 ms", "total ms");
+    for(int phase = 0; phase < PhaseCount; ++phase) {
+        std::vector<double> times;
+        double total = 0.0;
+        for(const auto& result : results) {
+            if(result.succeeded) {
+                times.push_back(result.phaseTimes[phase]);
+                total += result.phaseTimes[phase];
+            }
+        }
+
+        auto p50 = percentile(times, 0.50);
+        auto p99 = percentile(times, 0.99);
+        std::printf("%-8s %10.3f %10.3f %10.3f\n", phaseNames[phase], p50, p99, total);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if(!setup(argc, argv, options)) {
         return help();
     }
 
-    auto bitmap = document->renderToBitmap(width, height, bgColor);
-    if(bitmap.isNull()) {
+    std::vector<std::string> filenames;
+    for(const auto& input : options.inputs)
+        expandInput(input, filenames);
+    if(filenames.empty()) {
         return help();
     }
 
-    auto lastSlashIndex = filename.find_last_of("/\\");
-    auto basename = lastSlashIndex == std::string::npos ? filename : filename.substr(lastSlashIndex + 1);
-    basename.append(".png");
+    if(!options.outputDirectory.empty()) {
+        std::error_code ec;
+        fs::create_directories(options.outputDirectory, ec);
+    }
+
+    // The font cache is per thread; every worker registers the same font data, which is read once.
+    auto registerFonts = [&options]() {
+        for(const auto& font : options.fonts) {
+            lunasvg_add_font_face_from_data(font.family.c_str(), false, false, font.data.data(), font.data.size(), nullptr, nullptr);
+        }
+    };
+
+    std::vector<FileResult> results(filenames.size());
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        registerFonts();
+        for(auto index = nextIndex++; index < filenames.size(); index = nextIndex++) {
+            convertFile(options, filenames[index], results[index]);
+        }
+    };
+
+    auto threadCount = static_cast<unsigned>(std::min<size_t>(options.threadCount, filenames.size()));
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(unsigned i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if(filenames.size() == 1) {
+        if(!results.front().succeeded)
+            return help();
+        for(const auto& size : options.sizes)
+            std::cout << "Generated PNG file: " << outputFilename(options, filenames.front(), size) << std::endl;
+        return 0;
+    }
 
-    bitmap.writeToPng(basename);
-    std::cout << "Generated PNG file: " << basename << std::endl;
-    return 0;
+    printReport(results, filenames.size() * options.sizes.size(), threadCount, elapsed.count());
+    auto failed = std::any_of(results.begin(), results.end(), [](const FileResult& result) { return !result.succeeded; });
+    return failed ? 1 : 0;
 }
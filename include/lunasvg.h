@@ -23,7 +23,10 @@
 #ifndef LUNASVG_H
 #define LUNASVG_H
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <vector>
@@ -129,6 +132,80 @@ LUNASVG_API bool lunasvg_add_font_face_from_data(const char* family, bool bold,
 
 namespace lunasvg {
 
+/**
+ * @brief Pixel layouts that rendering can write into.
+ */
+enum class PixelFormat : uint8_t {
+    ARGB32_Premultiplied, ///< Native-endian 32-bit words holding premultiplied 0xAARRGGBB; the Bitmap format.
+    RGBA8888, ///< Bytes in R, G, B, A order with plain (unpremultiplied) alpha.
+    RGBA8888_Premultiplied, ///< Bytes in R, G, B, A order with premultiplied alpha.
+    BGRA8888, ///< Bytes in B, G, R, A order with plain (unpremultiplied) alpha.
+    RGB565, ///< Native-endian 16-bit words; premultiplied color, so alpha acts as compositing over black.
+    A8 ///< One byte of coverage (alpha) per pixel.
+};
+
+/**
+ * @brief Describes caller-owned pixel memory that rendering writes into.
+ */
+class LUNASVG_API RenderTarget {
+public:
+    /**
+     * @brief Constructs a null render target.
+     */
+    RenderTarget() = default;
+
+    /**
+     * @brief Constructs a render target over the provided pixel memory.
+     * @param data A pointer to the first row of pixels. It must be aligned to at least 4 bytes.
+     * @param width The width of the target in pixels.
+     * @param height The height of the target in pixels.
+     * @param stride The number of bytes per row of pixel data (stride).
+     * @param format The layout of the pixels in memory.
+     */
+    RenderTarget(uint8_t* data, int width, int height, int stride, PixelFormat format = PixelFormat::ARGB32_Premultiplied);
+
+    /**
+     * @brief Returns the number of bytes each pixel occupies in the target format.
+     * @return The size of one pixel in bytes.
+     */
+    int bytesPerPixel() const;
+
+    /**
+     * @brief Checks if the render target is null.
+     * @return True if the target has no memory or an invalid geometry, false otherwise.
+     */
+    bool isNull() const;
+
+    uint8_t* data{nullptr}; ///< A pointer to the first row of pixels.
+    int width{0}; ///< The width of the target in pixels.
+    int height{0}; ///< The height of the target in pixels.
+    int stride{0}; ///< The number of bytes per row of pixel data.
+    PixelFormat format{PixelFormat::ARGB32_Premultiplied}; ///< The layout of the pixels in memory.
+};
+
+/**
+ * @brief Row filters applied before deflate compression when encoding PNG.
+ */
+enum class PngFilter : uint8_t {
+    None, ///< Rows are stored unfiltered.
+    Sub, ///< Each byte is predicted from the pixel to its left.
+    Up, ///< Each byte is predicted from the pixel above.
+    Average, ///< Each byte is predicted from the average of the left and above pixels.
+    Paeth, ///< Each byte is predicted with the Paeth predictor.
+    Adaptive ///< The filter is chosen per row by the minimum sum of absolute differences.
+};
+
+/**
+ * @brief Options that control how a bitmap is encoded as PNG.
+ */
+class LUNASVG_API PngOptions {
+public:
+    int compressionLevel{6}; ///< The deflate effort, from 0 (store only) to 9 (smallest output).
+    PngFilter filter{PngFilter::Adaptive}; ///< The row filter strategy.
+    int threadCount{1}; ///< The number of threads that deflate blocks of rows in parallel, at least 1. Smaller values are treated as 1.
+    bool palette{false}; ///< Writes an indexed image when the bitmap has at most 256 distinct colors.
+};
+
 /**
 * @note Bitmap pixel format is ARGB32_Premultiplied.
 */
@@ -234,6 +311,14 @@ public:
      */
     void convertToRGBA();
 
+    /**
+     * @brief Converts the bitmap pixel data into a render target in a single pass.
+     * @note The target may alias the bitmap memory when its format has 32-bit pixels.
+     * @param target The render target to write into. It must have the same dimensions as the bitmap.
+     * @return True if the pixels were converted, false otherwise.
+     */
+    bool convertTo(const RenderTarget& target) const;
+
     /**
      * @brief Checks if the bitmap is null.
      * @return True if the bitmap is null, false otherwise.
@@ -262,14 +347,252 @@ public:
      */
     bool writeToPng(lunasvg_write_func_t callback, void* closure) const;
 
+    /**
+     * @brief Writes the bitmap to a PNG file using the built-in encoder.
+     * @param filename The name of the file to write.
+     * @param options The encoder options.
+     * @return True if the file was written successfully, false otherwise.
+     */
+    bool writeToPng(const std::string& filename, const PngOptions& options) const;
+
+    /**
+     * @brief Writes the bitmap to a PNG stream using the built-in encoder.
+     * @param callback Callback function for writing data.
+     * @param closure User-defined data passed to the callback.
+     * @param options The encoder options.
+     * @return True if successful, false otherwise.
+     */
+    bool writeToPng(lunasvg_write_func_t callback, void* closure, const PngOptions& options) const;
+
+    /**
+     * @brief Writes the bitmap to a QOI file with plain (unpremultiplied) alpha.
+     * @param filename The name of the file to write.
+     * @return True if the file was written successfully, false otherwise.
+     */
+    bool writeToQoi(const std::string& filename) const;
+
+    /**
+     * @brief Writes the bitmap to a QOI stream with plain (unpremultiplied) alpha.
+     * @param callback Callback function for writing data.
+     * @param closure User-defined data passed to the callback.
+     * @return True if successful, false otherwise.
+     */
+    bool writeToQoi(lunasvg_write_func_t callback, void* closure) const;
+
+    /**
+     * @brief Writes the bitmap to a PAM (RGB_ALPHA) file with plain alpha.
+     * @param filename The name of the file to write.
+     * @return True if the file was written successfully, false otherwise.
+     */
+    bool writeToPam(const std::string& filename) const;
+
+    /**
+     * @brief Writes the bitmap to a PAM (RGB_ALPHA) stream with plain alpha.
+     * @param callback Callback function for writing data.
+     * @param closure User-defined data passed to the callback.
+     * @return True if successful, false otherwise.
+     */
+    bool writeToPam(lunasvg_write_func_t callback, void* closure) const;
+
+    /**
+     * @brief Writes the bitmap to a binary PPM file.
+     * @note PPM has no alpha channel; pixels are written as if composited over black.
+     * @param filename The name of the file to write.
+     * @return True if the file was written successfully, false otherwise.
+     */
+    bool writeToPpm(const std::string& filename) const;
+
+    /**
+     * @brief Writes the bitmap to a binary PPM stream.
+     * @note PPM has no alpha channel; pixels are written as if composited over black.
+     * @param callback Callback function for writing data.
+     * @param closure User-defined data passed to the callback.
+     * @return True if successful, false otherwise.
+     */
+    bool writeToPpm(lunasvg_write_func_t callback, void* closure) const;
+
+    /**
+     * @brief Writes the premultiplied pixels to a raw file.
+     *
+     * The output is a 16-byte header followed by tightly packed rows. The header holds the magic "LRAW",
+     * then the width, the height and a format tag of 0, each as a little-endian 32-bit integer.
+     * Each pixel is stored as premultiplied B, G, R, A bytes.
+     *
+     * @param filename The name of the file to write.
+     * @return True if the file was written successfully, false otherwise.
+     */
+    bool writeToRaw(const std::string& filename) const;
+
+    /**
+     * @brief Writes the premultiplied pixels to a raw stream.
+     * @note See `writeToRaw(const std::string&)` for the layout.
+     * @param callback Callback function for writing data.
+     * @param closure User-defined data passed to the callback.
+     * @return True if successful, false otherwise.
+     */
+    bool writeToRaw(lunasvg_write_func_t callback, void* closure) const;
+
     /**
      * @internal
      */
     plutovg_surface_t* surface() const { return m_surface; }
 
 private:
+    friend class BitmapPool;
+    Bitmap(std::shared_ptr<uint8_t> storage, int width, int height, int stride);
     plutovg_surface_t* release();
     plutovg_surface_t* m_surface{nullptr};
+    std::shared_ptr<uint8_t> m_storage;
+};
+
+class PngStreamEncoderState;
+
+/**
+ * @brief Encodes a PNG image incrementally from successive bands of rows.
+ * @note Streamed images are always written as 8-bit RGBA; `PngOptions::palette` is ignored.
+ */
+class LUNASVG_API PngStreamEncoder {
+public:
+    /**
+     * @brief Writes the PNG header for an image of the specified size.
+     * @param width The width of the image in pixels.
+     * @param height The height of the image in pixels.
+     * @param callback Callback function for writing data.
+     * @param closure User-defined data passed to the callback.
+     * @param options The encoder options.
+     */
+    PngStreamEncoder(int width, int height, lunasvg_write_func_t callback, void* closure, const PngOptions& options = PngOptions());
+
+    /**
+     * @brief Cleans up any resources associated with the encoder.
+     */
+    ~PngStreamEncoder();
+
+    /**
+     * @brief Compresses and writes the next rows of the image.
+     * @param rows A bitmap holding the next rows; its width must match the image width.
+     * @return True if the rows were written, false otherwise.
+     */
+    bool writeRows(const Bitmap& rows);
+
+    /**
+     * @brief Completes the image once every row has been written.
+     * @return True if the image was completed, false otherwise.
+     */
+    bool finish();
+
+private:
+    PngStreamEncoder(const PngStreamEncoder&) = delete;
+    PngStreamEncoder& operator=(const PngStreamEncoder&) = delete;
+    std::unique_ptr<PngStreamEncoderState> m_state;
+};
+
+/**
+ * @brief Receives one band of a banded render.
+ *
+ * The band bitmap is reused for the next band once the callback returns.
+ * Returning false stops the render.
+ */
+using BandCallback = std::function<bool(const Bitmap& band, int y)>;
+
+/**
+ * @brief The dimensions of one output of a batch render.
+ *
+ * A non-positive dimension is derived from the other one and the intrinsic aspect ratio, as in `Document::renderToBitmap`.
+ */
+class LUNASVG_API RenderSize {
+public:
+    RenderSize() = default;
+    RenderSize(int width, int height) : width(width), height(height) {}
+
+    int width{-1}; ///< The width in pixels, or -1 to auto-scale.
+    int height{-1}; ///< The height in pixels, or -1 to auto-scale.
+};
+
+/**
+ * @brief Trade-offs between rendering speed and antialiasing accuracy.
+ */
+enum class RenderQuality : uint8_t {
+    Fast, ///< Rasterizes at half resolution and upsamples, for previews such as interactive zoom.
+    Normal, ///< Uses the default antialiasing of the rasterizer.
+    High ///< Also draws strokes thinner than a device pixel one pixel wide, with coverage scaled by their width.
+};
+
+/**
+ * @brief A flag that lets another thread stop a render in progress.
+ *
+ * The render checks the token between elements, so it stops shortly after `cancel` is called.
+ */
+class LUNASVG_API CancellationToken {
+public:
+    CancellationToken() = default;
+
+    /**
+     * @brief Requests that renders observing this token stop.
+     */
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief Clears a previous cancellation so the token can be reused.
+     */
+    void reset() { m_cancelled.store(false, std::memory_order_relaxed); }
+
+    /**
+     * @brief Checks whether cancellation was requested.
+     * @return True if `cancel` was called since the last `reset`, otherwise false.
+     */
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+    std::atomic<bool> m_cancelled{false};
+};
+
+/**
+ * @brief Bounds on the work and memory a document may use.
+ *
+ * A value of zero leaves the corresponding quantity unlimited. Documents that exceed a load
+ * limit fail to load. Renders that exceed a render limit stop early and leave the output
+ * partially drawn.
+ */
+class LUNASVG_API ResourceLimits {
+public:
+    size_t maxElements{0}; ///< The maximum number of elements in the markup.
+    size_t maxUseExpansion{0}; ///< The maximum number of elements cloned while expanding `<use>` references.
+    size_t maxLayerBytes{0}; ///< The maximum number of bytes held at once by offscreen layers, masks and pattern tiles during a render.
+    int maxLayerSize{0}; ///< The maximum width or height in pixels of a single offscreen layer, mask or pattern tile.
+    size_t maxPathSegments{0}; ///< The maximum number of path segments drawn by a single render.
+    double maxRenderTime{0}; ///< The maximum duration of a single render in milliseconds.
+};
+
+/**
+ * @brief The outcome of a render made with `RenderOptions`.
+ *
+ * Any status other than `Completed` means the render stopped early and the bitmap holds a partial result.
+ */
+enum class RenderStatus : uint8_t {
+    Completed, ///< Every element was drawn.
+    Cancelled, ///< The cancellation token was cancelled.
+    TimedOut, ///< The timeout or the `maxRenderTime` limit elapsed.
+    LimitExceeded ///< A layer or path segment limit was exceeded.
+};
+
+/**
+ * @brief Receives the coarse result of a progressive render before the full-quality pass starts.
+ */
+using ProgressCallback = std::function<void(const Bitmap& bitmap)>;
+
+/**
+ * @brief Options that control how a document or element is rendered.
+ */
+class LUNASVG_API RenderOptions {
+public:
+    RenderQuality quality{RenderQuality::Normal}; ///< The antialiasing quality.
+    const CancellationToken* cancellationToken{nullptr}; ///< An optional token that stops the render when cancelled.
+    double timeout{0}; ///< The time in milliseconds after which the render stops, or zero for no timeout.
+    bool progressive{false}; ///< Draws a `RenderQuality::Fast` pass first, then replaces it with the requested quality once that pass completes.
+    ProgressCallback progressCallback; ///< Called with the bitmap after the coarse pass of a progressive render.
 };
 
 class Rect;
@@ -464,115 +787,433 @@ public:
     float f{0}; ///< The vertical translation offset.
 };
 
-class SVGNode;
-class SVGTextNode;
-class SVGElement;
+/**
+ * @brief A snapshot of the counters of a `BitmapPool`.
+ */
+class LUNASVG_API BitmapPoolStats {
+public:
+    size_t allocations{0}; ///< The number of bitmaps allocated because no idle bitmap matched.
+    size_t reuses{0}; ///< The number of requests served by an idle bitmap.
+    size_t releases{0}; ///< The number of bitmaps returned to the pool.
+    size_t evictions{0}; ///< The number of idle bitmaps freed to stay within the byte limit.
+    size_t idleBitmaps{0}; ///< The number of bitmaps currently held by the pool.
+    size_t idleBytes{0}; ///< The number of bytes currently held by the pool.
+    size_t clearedPixels{0}; ///< The number of pixels cleared while preparing pooled renders.
+    size_t skippedPixels{0}; ///< The number of pixels lazy clearing did not have to touch.
+};
 
-class Element;
-class TextNode;
+class BitmapPoolState;
 
-class LUNASVG_API Node {
+/**
+ * @brief A thread-safe cache of bitmaps for renders that repeat a few fixed sizes.
+ *
+ * Pooled pixel memory is aligned to cache lines, and buffers of 2 MiB or more are aligned and
+ * padded to 2 MiB so the allocator can back them with huge pages. A bitmap handed out by the pool
+ * keeps its memory alive on its own, so it may outlive the pool.
+ *
+ * With lazy clearing enabled, a bitmap rendered through `renderToBitmap(BitmapPool&, ...)` remembers
+ * the device region the content covered, and the next render into it only clears that region.
+ * Bitmaps must then be released unmodified.
+ */
+class LUNASVG_API BitmapPool {
 public:
     /**
-     * @brief Constructs a null node.
-     */
-    Node() = default;
-
-    /**
-     * @brief Checks if the node is a text node.
-     * @return True if the node is a text node, false otherwise.
+     * @brief Constructs an empty pool.
+     * @param maxBytes The maximum number of bytes held by idle bitmaps.
+     * @param lazyClear Whether pooled renders only clear the region drawn by the previous render.
      */
-    bool isTextNode() const;
+    explicit BitmapPool(size_t maxBytes = 64 * 1024 * 1024, bool lazyClear = false);
 
     /**
-     * @brief Checks if the node is an element node.
-     * @return True if the node is an element node, false otherwise.
+     * @brief Frees the idle bitmaps. Bitmaps still in use remain valid.
      */
-    bool isElement() const;
+    ~BitmapPool();
 
     /**
-     * @brief Converts the node to a TextNode.
-     * @return A TextNode or a null node if conversion is not possible.
+     * @brief Returns a bitmap of the specified size, reusing an idle one when possible.
+     * @note The pixels of the returned bitmap are unspecified.
+     * @param width The width of the bitmap in pixels.
+     * @param height The height of the bitmap in pixels.
+     * @return A bitmap of the requested size, or a null bitmap if memory cannot be allocated.
      */
-    TextNode toTextNode() const;
+    Bitmap acquire(int width, int height);
 
     /**
-     * @brief Converts the node to an Element.
-     * @return An Element or a null node if conversion is not possible.
+     * @brief Returns a bitmap to the pool.
+     * @note Bitmaps that were not allocated by a pool, or that are still shared with copies, are simply dropped.
+     * @param bitmap The bitmap to return.
      */
-    Element toElement() const;
+    void release(Bitmap bitmap);
 
     /**
-     * @brief Returns the parent element.
-     * @return The parent element of this node. If this node has no parent, a null `Element` is returned.
+     * @brief Frees every idle bitmap.
      */
-    Element parentElement() const;
+    void clear();
 
     /**
-     * @brief Checks if the node is null.
-     * @return True if the node is null, false otherwise.
+     * @brief Returns the current counters of the pool.
+     * @return A snapshot of the pool statistics.
      */
-    bool isNull() const { return m_node == nullptr; }
+    BitmapPoolStats stats() const;
 
     /**
-     * @brief Checks if two nodes are equal.
-     * @param element The node to compare.
-     * @return True if equal, otherwise false.
+     * @internal
      */
-    bool operator==(const Node& node) const { return m_node == node.m_node; }
+    Bitmap acquire(int width, int height, uint32_t backgroundColor, const Box& damageRect);
 
-    /**
-     * @brief Checks if two nodes are not equal.
-     * @param element The node to compare.
-     * @return True if not equal, otherwise false.
-     */
-    bool operator!=(const Node& node) const { return m_node != node.m_node; }
+private:
+    BitmapPool(const BitmapPool&) = delete;
+    BitmapPool& operator=(const BitmapPool&) = delete;
+    std::unique_ptr<BitmapPoolState> m_state;
+};
 
-protected:
-    Node(SVGNode* node);
-    SVGNode* node() const { return m_node; }
-    SVGNode* m_node{nullptr};
-    friend class Element;
+/**
+ * @brief A snapshot of the counters of a `RenderCache`.
+ */
+class LUNASVG_API RenderCacheStats {
+public:
+    size_t hits{0}; ///< The number of renders served from the cache.
+    size_t misses{0}; ///< The number of renders that had to be drawn.
+    size_t evictions{0}; ///< The number of results dropped to stay within the byte limit.
+    size_t entries{0}; ///< The number of results currently held by the cache.
+    size_t bytes{0}; ///< The number of bytes currently held by the cache.
 };
 
-using NodeList = std::vector<Node>;
+class RenderCacheState;
 
-class LUNASVG_API TextNode : public Node {
+/**
+ * @brief A thread-safe cache of rendered bitmaps, used by `Document::renderToBitmap(RenderCache&, ...)`.
+ *
+ * Results are keyed by the document and its version, the render size, matrix and background color.
+ * Each document gets a version unique within the process when it is loaded, and a new one whenever it
+ * is modified through `Element::setAttribute`, `TextNode::setData`, `FrameRenderer` or `applyStyleSheet`,
+ * or laid out again by `updateLayout`, which reloads image files and picks up newly added font faces.
+ * Results are never shared between documents, even with identical sources, and stale results are never
+ * returned. Renders stopped early by a resource limit are not stored.
+ *
+ * With compression enabled, results are stored in the lossless QOI format, which shrinks flat vector
+ * art several times at the cost of an encode per store and a decode per hit.
+ */
+class LUNASVG_API RenderCache {
 public:
     /**
-     * @brief Constructs a null text node.
+     * @brief Constructs an empty cache.
+     * @param maxBytes The maximum number of bytes held by cached results.
+     * @param compress Whether results are stored QOI-compressed rather than as raw pixels.
      */
-    TextNode() = default;
+    explicit RenderCache(size_t maxBytes = 64 * 1024 * 1024, bool compress = true);
 
     /**
-     * @brief Returns the text content of the node.
-     * @return A string representing the text content.
+     * @brief Frees every cached result.
      */
-    const std::string& data() const;
+    ~RenderCache();
 
     /**
-     * @brief Sets the text content of the node.
-     * @param data The new text content to set.
+     * @brief Frees every cached result.
      */
-    void setData(const std::string& data);
+    void clear();
+
+    /**
+     * @brief Returns the current counters of the cache.
+     * @return A snapshot of the cache statistics.
+     */
+    RenderCacheStats stats() const;
 
 private:
-    TextNode(SVGTextNode* text);
-    SVGTextNode* text() const;
-    friend class Node;
+    RenderCache(const RenderCache&) = delete;
+    RenderCache& operator=(const RenderCache&) = delete;
+    std::unique_ptr<RenderCacheState> m_state;
+    friend class Document;
 };
 
-class LUNASVG_API Element : public Node {
+/**
+ * @brief One tile of an XYZ tile pyramid over a document.
+ */
+class LUNASVG_API Tile {
 public:
-    /**
-     * @brief Constructs a null element.
-     */
-    Element() = default;
+    int x{0}; ///< The tile column.
+    int y{0}; ///< The tile row.
+    int z{0}; ///< The zoom level.
+    Box rect; ///< The region of the document covered by the tile.
+};
 
-    /**
-     * @brief Checks if the element has a specific attribute.
-     * @param name The name of the attribute to check.
-     * @return True if the element has the specified attribute, false otherwise.
+/**
+ * @brief A snapshot of the per-phase timings and counters of a `Document`.
+ *
+ * The load phases are always recorded while the document is parsed. The layout and render
+ * figures are only collected while statistics are enabled with `Document::setStatisticsEnabled`.
+ */
+class LUNASVG_API DocumentStatistics {
+public:
+    double tokenizeTime{0}; ///< Milliseconds spent tokenizing the markup and creating elements.
+    double cascadeTime{0}; ///< Milliseconds spent matching and applying stylesheet rules.
+    double buildTime{0}; ///< Milliseconds spent building the tree, including `<use>` clones.
+    double layoutTime{0}; ///< Milliseconds spent in `updateLayout`.
+    double renderTime{0}; ///< Milliseconds spent rendering.
+    uint64_t elementsCreated{0}; ///< The number of elements created by the parser.
+    uint64_t attributesSet{0}; ///< The number of attribute and style declarations applied while loading.
+    uint64_t rulesTested{0}; ///< The number of stylesheet rules tested against an element.
+    uint64_t rulesMatched{0}; ///< The number of stylesheet rules that matched an element.
+    uint64_t layersAllocated{0}; ///< The number of offscreen layers allocated for group compositing.
+    uint64_t layerPixels{0}; ///< The total number of pixels of those layers.
+    uint64_t maskRenders{0}; ///< The number of masks rendered.
+    uint64_t clipMaskRenders{0}; ///< The number of clip paths rendered to a coverage mask.
+    uint64_t gradientResolutions{0}; ///< The number of gradients resolved for painting.
+    uint64_t patternResolutions{0}; ///< The number of pattern tiles rendered for painting.
+    uint64_t imageDecodes{0}; ///< The number of images decoded by layout.
+    uint64_t glyphsDrawn{0}; ///< The number of glyphs filled or stroked.
+};
+
+/**
+ * @brief Caps checked against a `RenderCost` before committing to a render.
+ *
+ * A value of zero leaves the corresponding quantity unlimited.
+ */
+class LUNASVG_API RenderBudget {
+public:
+    uint64_t maxTotalPixels{0}; ///< The maximum estimated pixel work, see `RenderCost::totalPixels`.
+    uint64_t maxPeakLayerPixels{0}; ///< The maximum number of layer and mask pixels alive at once.
+    uint64_t maxPathSegments{0}; ///< The maximum number of path segments rasterized.
+    uint64_t maxGlyphs{0}; ///< The maximum number of glyphs drawn.
+};
+
+/**
+ * @brief An estimate of the work needed to render a document, produced by `Document::estimateCost`.
+ */
+class LUNASVG_API RenderCost {
+public:
+    uint64_t pathSegments{0}; ///< The number of path segments filled or stroked, markers and pattern tiles included.
+    uint64_t coveragePixels{0}; ///< The device area covered by fills, strokes and images.
+    uint64_t layers{0}; ///< The number of offscreen layers needed for opacity, masks and clip masks.
+    uint64_t layerPixels{0}; ///< The total pixel area of those layers.
+    uint64_t peakLayerPixels{0}; ///< The largest pixel area of layers and masks alive at the same time.
+    uint64_t masks{0}; ///< The number of masks rendered.
+    uint64_t maskPixels{0}; ///< The total pixel area of those masks.
+    uint64_t clipMasks{0}; ///< The number of clip paths rendered to a coverage mask.
+    uint64_t clipMaskPixels{0}; ///< The total pixel area of those clip masks.
+    uint64_t patternTiles{0}; ///< The number of pattern tiles rendered.
+    uint64_t markers{0}; ///< The number of markers rendered.
+    uint64_t glyphs{0}; ///< The number of glyphs filled or stroked.
+    uint64_t images{0}; ///< The number of images drawn.
+
+    /**
+     * @brief Returns the estimated pixel work, covering drawing, layers, masks and clip masks.
+     * @return The sum of the pixel areas of the report.
+     */
+    uint64_t totalPixels() const { return coveragePixels + layerPixels + maskPixels + clipMaskPixels; }
+
+    /**
+     * @brief Checks the estimate against a budget.
+     * @param budget The caps to check.
+     * @return True if no capped quantity exceeds its cap, otherwise false.
+     */
+    bool fits(const RenderBudget& budget) const;
+};
+
+/**
+ * @brief The heap footprint of a `Document`, in bytes, broken down by category.
+ *
+ * The figures count the bytes requested from the allocator and leave out its per-block overhead.
+ */
+class LUNASVG_API MemoryUsage {
+public:
+    size_t nodes{0}; ///< Element and text node objects, including the links of their child lists.
+    size_t attributes{0}; ///< Attribute records, their string values and the tokenized class lists.
+    size_t paths{0}; ///< Path data parsed from `d` or built for shapes, and marker positions.
+    size_t properties{0}; ///< Parsed property lists and the heap data of properties such as length, number and point lists.
+    size_t images{0}; ///< Decoded `<image>` pixels.
+    size_t text{0}; ///< Character data, and the laid-out characters and fragments of `<text>` elements.
+    size_t idCache{0}; ///< The id and class lookup tables.
+    size_t useClones{0}; ///< Every category above for the subtrees cloned by `<use>` elements, which are not counted elsewhere.
+
+    /**
+     * @brief Returns the footprint of the whole document.
+     * @return The sum of every category.
+     */
+    size_t total() const { return nodes + attributes + paths + properties + images + text + idCache + useClones; }
+};
+
+class SVGNode;
+class SVGTextNode;
+class SVGElement;
+
+class Element;
+class TextNode;
+
+class LUNASVG_API Node {
+public:
+    /**
+     * @brief Constructs a null node.
+     */
+    Node() = default;
+
+    /**
+     * @brief Checks if the node is a text node.
+     * @return True if the node is a text node, false otherwise.
+     */
+    bool isTextNode() const;
+
+    /**
+     * @brief Checks if the node is an element node.
+     * @return True if the node is an element node, false otherwise.
+     */
+    bool isElement() const;
+
+    /**
+     * @brief Converts the node to a TextNode.
+     * @return A TextNode or a null node if conversion is not possible.
+     */
+    TextNode toTextNode() const;
+
+    /**
+     * @brief Converts the node to an Element.
+     * @return An Element or a null node if conversion is not possible.
+     */
+    Element toElement() const;
+
+    /**
+     * @brief Returns the parent element.
+     * @return The parent element of this node. If this node has no parent, a null `Element` is returned.
+     */
+    Element parentElement() const;
+
+    /**
+     * @brief Returns the previous sibling node.
+     * @return The node before this one in its parent, or a null node if this is the first child.
+     */
+    Node previousSibling() const;
+
+    /**
+     * @brief Returns the next sibling node.
+     * @return The node after this one in its parent, or a null node if this is the last child.
+     */
+    Node nextSibling() const;
+
+    /**
+     * @brief Checks if the node is null.
+     * @return True if the node is null, false otherwise.
+     */
+    bool isNull() const { return m_node == nullptr; }
+
+    /**
+     * @brief Checks if two nodes are equal.
+     * @param element The node to compare.
+     * @return True if equal, otherwise false.
+     */
+    bool operator==(const Node& node) const { return m_node == node.m_node; }
+
+    /**
+     * @brief Checks if two nodes are not equal.
+     * @param element The node to compare.
+     * @return True if not equal, otherwise false.
+     */
+    bool operator!=(const Node& node) const { return m_node != node.m_node; }
+
+protected:
+    Node(SVGNode* node);
+    SVGNode* node() const { return m_node; }
+    SVGNode* m_node{nullptr};
+    friend class Element;
+};
+
+using NodeList = std::vector<Node>;
+using ElementList = std::vector<Element>;
+
+/**
+ * @brief A forward iterator over sibling nodes that follows the sibling links and allocates nothing.
+ */
+class LUNASVG_API NodeIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Node;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Node*;
+    using reference = const Node&;
+
+    /**
+     * @brief Constructs a past-the-end iterator.
+     */
+    NodeIterator() = default;
+
+    /**
+     * @brief Constructs an iterator positioned at a node.
+     * @param node The node to start from.
+     */
+    explicit NodeIterator(const Node& node) : m_node(node) {}
+
+    reference operator*() const { return m_node; }
+    pointer operator->() const { return &m_node; }
+
+    NodeIterator& operator++() { m_node = m_node.nextSibling(); return *this; }
+    NodeIterator operator++(int) { auto it = *this; ++*this; return it; }
+
+    bool operator==(const NodeIterator& it) const { return m_node == it.m_node; }
+    bool operator!=(const NodeIterator& it) const { return m_node != it.m_node; }
+
+private:
+    Node m_node;
+};
+
+/**
+ * @brief The child nodes of an element, for use in range-based for loops.
+ */
+class LUNASVG_API NodeRange {
+public:
+    /**
+     * @brief Constructs a range starting at a node and running to its last sibling.
+     * @param first The first node of the range, or a null node for an empty range.
+     */
+    explicit NodeRange(const Node& first) : m_first(first) {}
+
+    NodeIterator begin() const { return NodeIterator(m_first); }
+    NodeIterator end() const { return NodeIterator(); }
+
+    /**
+     * @brief Checks if the range is empty.
+     * @return True if there are no nodes in the range, otherwise false.
+     */
+    bool empty() const { return m_first.isNull(); }
+
+private:
+    Node m_first;
+};
+
+class LUNASVG_API TextNode : public Node {
+public:
+    /**
+     * @brief Constructs a null text node.
+     */
+    TextNode() = default;
+
+    /**
+     * @brief Returns the text content of the node.
+     * @return A string representing the text content.
+     */
+    const std::string& data() const;
+
+    /**
+     * @brief Sets the text content of the node.
+     * @param data The new text content to set.
+     */
+    void setData(const std::string& data);
+
+private:
+    TextNode(SVGTextNode* text);
+    SVGTextNode* text() const;
+    friend class Node;
+};
+
+class LUNASVG_API Element : public Node {
+public:
+    /**
+     * @brief Constructs a null element.
+     */
+    Element() = default;
+
+    /**
+     * @brief Checks if the element has a specific attribute.
+     * @param name The name of the attribute to check.
+     * @return True if the element has the specified attribute, false otherwise.
      */
     bool hasAttribute(const std::string& name) const;
 
@@ -597,6 +1238,26 @@ public:
      */
     void render(Bitmap& bitmap, const Matrix& matrix = Matrix()) const;
 
+    /**
+     * @brief Renders the element onto a bitmap using a transformation matrix and render options.
+     * @param bitmap The bitmap to render onto.
+     * @param matrix The root transformation matrix.
+     * @param options The options that control the render.
+     * @return `RenderStatus::Completed`, or the reason the render stopped early.
+     */
+    RenderStatus render(Bitmap& bitmap, const Matrix& matrix, const RenderOptions& options) const;
+
+    /**
+     * @brief Renders the element into caller-owned pixel memory in the requested pixel format.
+     * @note The target is cleared to the background color first. Targets with 32-bit pixels are rendered
+     * and then converted in place. Narrower formats such as RGB565 and A8 are rendered in horizontal bands
+     * through a 32-bit scratch band of at most 256K pixels, each converted into its target rows as it completes.
+     * @param target The render target to write into.
+     * @param matrix The root transformation matrix.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     */
+    void renderToTarget(const RenderTarget& target, const Matrix& matrix = Matrix(), uint32_t backgroundColor = 0x00000000) const;
+
     /**
      * @brief Renders the element to a bitmap with specified dimensions.
      * @param width The desired width in pixels, or -1 to auto-scale based on the intrinsic size.
@@ -606,6 +1267,17 @@ public:
      */
     Bitmap renderToBitmap(int width = -1, int height = -1, uint32_t backgroundColor = 0x00000000) const;
 
+    /**
+     * @brief Renders the element to a bitmap drawn from a pool.
+     * @note Hand the bitmap back with `BitmapPool::release` once it is no longer needed.
+     * @param pool The pool that provides the bitmap.
+     * @param width The desired width in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param height The desired height in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     * @return A Bitmap containing the raster representation of the element.
+     */
+    Bitmap renderToBitmap(BitmapPool& pool, int width = -1, int height = -1, uint32_t backgroundColor = 0x00000000) const;
+
     /**
      * @brief Retrieves the local transformation matrix of the element.
      * @return The matrix that applies only to the element, relative to its parent.
@@ -642,11 +1314,53 @@ public:
      */
     NodeList children() const;
 
+    /**
+     * @brief Returns the child nodes of this element as a range that allocates nothing.
+     * @return A range over the child nodes, in document order.
+     */
+    NodeRange childNodes() const;
+
+    /**
+     * @brief Returns the first child node.
+     * @return The first child node, or a null node if the element has no children.
+     */
+    Node firstChild() const;
+
+    /**
+     * @brief Returns the last child node.
+     * @return The last child node, or a null node if the element has no children.
+     */
+    Node lastChild() const;
+
+    /**
+     * @brief Finds the first descendant element that matches a CSS selector list.
+     * @param selector The selector list, for example "g > path.road, #marker".
+     * @return The first matching element in document order, or a null element if none matches or the selector is invalid.
+     */
+    Element querySelector(const std::string& selector) const;
+
+    /**
+     * @brief Finds every descendant element that matches a CSS selector list.
+     * @param selector The selector list, for example "g > path.road, #marker".
+     * @return The matching elements in document order, or an empty list if the selector is invalid.
+     */
+    ElementList querySelectorAll(const std::string& selector) const;
+
+    /**
+     * @brief Appends every descendant element that matches a CSS selector list to a caller-provided list.
+     * @note The list is not cleared first, so one list can be reused across queries without reallocating.
+     * @param selector The selector list, for example "g > path.road, #marker".
+     * @param elements The list that receives the matching elements in document order.
+     * @return The number of elements appended.
+     */
+    size_t querySelectorAll(const std::string& selector, ElementList& elements) const;
+
 private:
     Element(SVGElement* element);
     SVGElement* element() const;
     friend class Node;
     friend class Document;
+    friend class FrameRenderer;
 };
 
 class SVGRootElement;
@@ -682,6 +1396,43 @@ public:
      */
     static std::unique_ptr<Document> loadFromData(const char* data, size_t length);
 
+    /**
+     * @brief Load an SVG document from a file, enforcing resource limits.
+     * @param filename The path to the SVG file.
+     * @param limits The limits that apply while loading and to every later render.
+     * @return A pointer to the loaded `Document`, or `nullptr` on failure or if a load limit is exceeded.
+     */
+    static std::unique_ptr<Document> loadFromFile(const std::string& filename, const ResourceLimits& limits);
+
+    /**
+     * @brief Load an SVG document from a string, enforcing resource limits.
+     * @param string The string containing the SVG data.
+     * @param limits The limits that apply while loading and to every later render.
+     * @return A pointer to the loaded `Document`, or `nullptr` on failure or if a load limit is exceeded.
+     */
+    static std::unique_ptr<Document> loadFromData(const std::string& string, const ResourceLimits& limits);
+
+    /**
+     * @brief Load an SVG document from a string with a specified length, enforcing resource limits.
+     * @param data The string containing the SVG data.
+     * @param length The length of the string in bytes.
+     * @param limits The limits that apply while loading and to every later render.
+     * @return A pointer to the loaded `Document`, or `nullptr` on failure or if a load limit is exceeded.
+     */
+    static std::unique_ptr<Document> loadFromData(const char* data, size_t length, const ResourceLimits& limits);
+
+    /**
+     * @brief Replaces the limits applied to later renders.
+     * @param limits The new limits. The load limits no longer have any effect.
+     */
+    void setResourceLimits(const ResourceLimits& limits);
+
+    /**
+     * @brief Returns the limits applied to renders of this document.
+     * @return The resource limits.
+     */
+    const ResourceLimits& resourceLimits() const;
+
     /**
      * @brief Applies a CSS stylesheet to the document.
      * @param content A string containing the CSS rules to apply.
@@ -718,6 +1469,62 @@ public:
      */
     void render(Bitmap& bitmap, const Matrix& matrix = Matrix()) const;
 
+    /**
+     * @brief Renders the document onto a bitmap using a transformation matrix and render options.
+     * @param bitmap The bitmap to render onto.
+     * @param matrix The root transformation matrix.
+     * @param options The options that control the render.
+     * @return `RenderStatus::Completed`, or the reason the render stopped early.
+     */
+    RenderStatus render(Bitmap& bitmap, const Matrix& matrix, const RenderOptions& options) const;
+
+    /**
+     * @brief Renders a rectangle of the document so that it fills the bitmap.
+     *
+     * Output is clipped to the bitmap, and subtrees whose bounds fall outside it are skipped
+     * without being traversed, so the cost follows the content inside the region.
+     *
+     * @note Like `render`, the bitmap is not cleared first.
+     * @param bitmap The bitmap to render onto.
+     * @param sourceRect The region to render, in the coordinate space of `boundingBox`.
+     */
+    void renderRegion(Bitmap& bitmap, const Box& sourceRect) const;
+
+    /**
+     * @brief Renders a rectangle of the document with render options.
+     *
+     * Tile loops can stop as soon as a tile returns a status other than `RenderStatus::Completed`.
+     *
+     * @param bitmap The bitmap to render onto.
+     * @param sourceRect The region to render, in the coordinate space of `boundingBox`.
+     * @param options The options that control the render.
+     * @return `RenderStatus::Completed`, or the reason the render stopped early.
+     */
+    RenderStatus renderRegion(Bitmap& bitmap, const Box& sourceRect, const RenderOptions& options) const;
+
+    /**
+     * @brief Enumerates the XYZ tiles that cover the document at a zoom level.
+     *
+     * Zoom level 0 is a single square tile whose side is the larger of `width` and `height`.
+     * Each further level splits every tile into four. Tiles that lie entirely outside the
+     * document are omitted.
+     *
+     * @param zoom The zoom level, from 0 to 30.
+     * @return The tiles in row-major order, ready to be passed to `renderRegion`.
+     */
+    std::vector<Tile> tiles(int zoom) const;
+
+    /**
+     * @brief Renders the document into caller-owned pixel memory in the requested pixel format.
+     * @note The target is cleared to the background color first. Targets with 32-bit pixels are rendered
+     * and then converted in place. Narrower formats such as RGB565 and A8 are rendered in horizontal bands
+     * through a 32-bit scratch band of at most 256K pixels, each converted into its target rows as it completes.
+     * @param target The render target to write into.
+     * @param matrix The root transformation matrix.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     */
+    void renderToTarget(const RenderTarget& target, const Matrix& matrix = Matrix(), uint32_t backgroundColor = 0x00000000) const;
+
     /**
      * @brief Renders the document to a bitmap with specified dimensions.
      * @param width The desired width in pixels, or -1 to auto-scale based on the intrinsic size.
@@ -727,6 +1534,138 @@ public:
      */
     Bitmap renderToBitmap(int width = -1, int height = -1, uint32_t backgroundColor = 0x00000000) const;
 
+    /**
+     * @brief Renders the document to a bitmap drawn from a pool.
+     * @note Hand the bitmap back with `BitmapPool::release` once it is no longer needed.
+     * @param pool The pool that provides the bitmap.
+     * @param width The desired width in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param height The desired height in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     * @return A Bitmap containing the raster representation of the document.
+     */
+    Bitmap renderToBitmap(BitmapPool& pool, int width = -1, int height = -1, uint32_t backgroundColor = 0x00000000) const;
+
+    /**
+     * @brief Renders the document to a bitmap, reusing an identical earlier render held by a cache.
+     * @note The returned bitmap is never shared with the cache, so it may be modified freely.
+     * @param cache The cache to look up and store the result in.
+     * @param width The desired width in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param height The desired height in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     * @return A Bitmap containing the raster representation of the document.
+     */
+    Bitmap renderToBitmap(RenderCache& cache, int width = -1, int height = -1, uint32_t backgroundColor = 0x00000000) const;
+
+    /**
+     * @brief Renders the document in horizontal bands so the full bitmap is never held in memory.
+     *
+     * Each band is rendered with the document matrix translated to the band origin, so the concatenated
+     * bands reproduce the output of `renderToBitmap`. Peak memory is `width * bandHeight` pixels.
+     *
+     * @param width The desired width in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param height The desired height in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param bandHeight The number of rows in each band.
+     * @param callback The function that receives each completed band and its first row.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     * @return True if every band was rendered and accepted, false otherwise.
+     */
+    bool renderBands(int width, int height, int bandHeight, const BandCallback& callback, uint32_t backgroundColor = 0x00000000) const;
+
+    /**
+     * @brief Renders the document at several sizes in one call.
+     *
+     * This is a batch convenience equivalent to calling `renderToBitmap` once per size. Layout is shared,
+     * but each target is rasterized separately, so no flattened geometry is reused across sizes. With a
+     * `threadCount` above 1 the targets are spread over worker threads.
+     *
+     * @note Documents that contain text or images fall back to rendering every target on the calling
+     * thread, whatever `threadCount` is, because font faces and image surfaces cannot be shared between threads.
+     * @param sizes The dimensions of each output bitmap.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     * @param threadCount The maximum number of threads that render targets concurrently.
+     * @return One bitmap per requested size, in the same order. A bitmap is null if its size could not be resolved.
+     */
+    std::vector<Bitmap> renderBatch(const std::vector<RenderSize>& sizes, uint32_t backgroundColor = 0x00000000, int threadCount = 1) const;
+
+    /**
+     * @brief Estimates the cost of rendering the document at a given size, without rendering it.
+     *
+     * The laid-out tree is walked the way a render would walk it, skipping hidden and off-canvas
+     * subtrees. Layer, mask and clip mask areas follow the bounds the renderer would allocate.
+     *
+     * @param width The desired width in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param height The desired height in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @return The estimated cost, all zero if the size cannot be resolved.
+     */
+    RenderCost estimateCost(int width = -1, int height = -1) const;
+
+    /**
+     * @brief Measures the memory held by the document.
+     *
+     * Path data shared between a `d` attribute and its laid-out geometry is counted once.
+     *
+     * @return The heap footprint by category.
+     */
+    MemoryUsage memoryUsage() const;
+
+    /**
+     * @brief Enables or disables the collection of layout and render statistics.
+     * @note While disabled, layout and rendering only pay for a null check at each instrumented step.
+     * Disabling discards the layout and render figures. Do not toggle while the document is being rendered.
+     * @param enabled Whether statistics are collected.
+     */
+    void setStatisticsEnabled(bool enabled);
+
+    /**
+     * @brief Checks whether layout and render statistics are being collected.
+     * @return True if statistics are enabled, otherwise false.
+     */
+    bool isStatisticsEnabled() const;
+
+    /**
+     * @brief Returns the timings and counters gathered so far.
+     * @note Safe to call while other threads render the document.
+     * @return A snapshot of the document statistics.
+     */
+    DocumentStatistics statistics() const;
+
+    /**
+     * @brief Resets every timing and counter, including those recorded while loading.
+     */
+    void resetStatistics();
+
+    /**
+     * @brief Enables or disables render tracing.
+     *
+     * While tracing, every rendered element and every compositing step (group layers, clip masks,
+     * masks and pattern tiles) records a timed event with its tag, id and device bounding box.
+     * Each rendering thread appends to its own buffer under a lock that only `exportTrace` contends for.
+     *
+     * @note Disabling discards the recorded events. Do not toggle while the document is being rendered.
+     * @param enabled Whether events are recorded.
+     */
+    void setTracingEnabled(bool enabled);
+
+    /**
+     * @brief Checks whether render tracing is enabled.
+     * @return True if events are being recorded, otherwise false.
+     */
+    bool isTracingEnabled() const;
+
+    /**
+     * @brief Exports the recorded events in the Chrome trace event format.
+     * @note The result can be opened in Perfetto or `chrome://tracing`. It may be called while other threads
+     * render the document, in which case events still in progress report a zero duration.
+     * @return The trace as a JSON string, or an empty string if tracing is disabled.
+     */
+    std::string exportTrace() const;
+
+    /**
+     * @brief Discards the recorded events and keeps tracing enabled.
+     * @note Do not call while the document is being rendered.
+     */
+    void clearTrace();
+
     /**
      * @brief Retrieves an element by its ID.
      * @param id The ID of the element to retrieve.
@@ -740,6 +1679,40 @@ public:
      */
     Element documentElement() const;
 
+    /**
+     * @brief Finds the first element of the document that matches a CSS selector list.
+     * @param selector The selector list, for example "g > path.road, #marker".
+     * @return The first matching element in document order, or a null element if none matches or the selector is invalid.
+     */
+    Element querySelector(const std::string& selector) const;
+
+    /**
+     * @brief Finds every element of the document that matches a CSS selector list.
+     * @param selector The selector list, for example "g > path.road, #marker".
+     * @return The matching elements in document order, or an empty list if the selector is invalid.
+     */
+    ElementList querySelectorAll(const std::string& selector) const;
+
+    /**
+     * @brief Appends every element of the document that matches a CSS selector list to a caller-provided list.
+     * @note The list is not cleared first, so one list can be reused across queries without reallocating.
+     * @param selector The selector list, for example "g > path.road, #marker".
+     * @param elements The list that receives the matching elements in document order.
+     * @return The number of elements appended.
+     */
+    size_t querySelectorAll(const std::string& selector, ElementList& elements) const;
+
+    /**
+     * @brief Visits every node of the document in depth-first order, starting with the document element.
+     *
+     * The walk follows the sibling and parent links and allocates nothing.
+     *
+     * @note The tree must not be modified during the walk.
+     * @param callback A function taking a `const Node&`. Returning false skips the descendants of that node.
+     */
+    template<typename Callback>
+    void traverse(Callback callback) const;
+
     /**
      * @internal
      */
@@ -753,8 +1726,190 @@ private:
     Document();
     Document(const Document&) = delete;
     Document& operator=(const Document&) = delete;
-    bool parse(const char* data, size_t length);
+    bool parse(const char* data, size_t length, const ResourceLimits& limits);
     std::unique_ptr<SVGRootElement> m_rootElement;
+    DocumentStatistics m_loadStatistics;
+};
+
+template<typename Callback>
+inline void Document::traverse(Callback callback) const
+{
+    const Node root = documentElement();
+    Node node = root;
+    while(!node.isNull()) {
+        if(callback(node) && node.isElement()) {
+            if(auto child = node.toElement().firstChild(); !child.isNull()) {
+                node = child;
+                continue;
+            }
+        }
+
+        while(node != root) {
+            if(auto sibling = node.nextSibling(); !sibling.isNull()) {
+                node = sibling;
+                break;
+            }
+
+            node = node.parentElement();
+        }
+
+        if(node == root) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Timings and damage of one frame produced by a `FrameRenderer`.
+ */
+class LUNASVG_API FrameStats {
+public:
+    double layoutTime{0}; ///< Milliseconds spent applying attribute changes and updating the layout.
+    double renderTime{0}; ///< Milliseconds spent clearing and redrawing the damaged region.
+    int changedElements{0}; ///< The number of elements whose attributes changed for this frame.
+    bool fullLayout{false}; ///< Whether the whole document had to be laid out again.
+    Box damageRect; ///< The region of the bitmap that was redrawn, in pixels.
+};
+
+/**
+ * @brief Renders a sequence of frames of one document into a reused bitmap.
+ *
+ * Attribute changes are queued and applied together by `renderFrame`. Only the changed subtrees
+ * are laid out again, and only the pixels covered by their old and new bounds are redrawn.
+ * Changes that affect shared resources, such as the contents of `<defs>`, `<clipPath>` or
+ * gradients, an `id`, or the root element, fall back to a full layout and a full redraw.
+ */
+class LUNASVG_API FrameRenderer {
+public:
+    /**
+     * @brief Constructs a frame renderer for a document.
+     * @param document The document to animate. It must outlive the renderer.
+     * @param width The frame width in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param height The frame height in pixels, or -1 to auto-scale based on the intrinsic size.
+     * @param backgroundColor The background color in 0xRRGGBBAA format.
+     */
+    FrameRenderer(Document& document, int width = -1, int height = -1, uint32_t backgroundColor = 0x00000000);
+
+    /**
+     * @brief Queues an attribute change for the next frame.
+     * @param element The element to modify.
+     * @param name The name of the attribute.
+     * @param value The new value of the attribute.
+     */
+    void setAttribute(const Element& element, const std::string& name, const std::string& value);
+
+    /**
+     * @brief Applies the queued changes and redraws the damaged region of the frame.
+     * @return The bitmap holding the frame, or a null bitmap if the document has no size.
+     */
+    const Bitmap& renderFrame();
+
+    /**
+     * @brief Returns the bitmap holding the most recent frame.
+     * @return The frame bitmap.
+     */
+    const Bitmap& bitmap() const { return m_bitmap; }
+
+    /**
+     * @brief Returns the statistics of the most recent frame.
+     * @return The frame statistics.
+     */
+    const FrameStats& stats() const { return m_stats; }
+
+private:
+    struct AttributeChange {
+        Element element;
+        std::string name;
+        std::string value;
+    };
+
+    Document* m_document;
+    Bitmap m_bitmap;
+    uint32_t m_backgroundColor;
+    bool m_fullRedraw{true};
+    std::vector<AttributeChange> m_changes;
+    FrameStats m_stats;
+};
+
+/**
+ * @brief A snapshot of the counters of a `DocumentCache`.
+ */
+class LUNASVG_API DocumentCacheStats {
+public:
+    size_t hits{0}; ///< The number of loads served by a cached document.
+    size_t misses{0}; ///< The number of loads that had to parse their input.
+    size_t evictions{0}; ///< The number of documents dropped to stay within the byte limit.
+    size_t documents{0}; ///< The number of documents currently held by the cache.
+    size_t bytes{0}; ///< The memory currently held by those documents, as reported by `Document::memoryUsage`, plus their source bytes.
+};
+
+class DocumentCacheState;
+
+/**
+ * @brief A thread-safe cache that parses each distinct SVG content once.
+ *
+ * Inputs are looked up by an XXH64 hash and matched by comparing their bytes with a copy kept
+ * in the cache, so identical content loaded from different sources shares one parsed and laid-out
+ * document. The least recently used documents are dropped once the cache holds more than its byte limit.
+ *
+ * Documents are handed out as shared handles to immutable documents, which may be rendered from
+ * several threads at once. A handle keeps its document alive after it leaves the cache.
+ *
+ * @note Documents with `<text>` or `<image>` content are parsed on every load and never cached,
+ * because font faces and image surfaces are reference counted without atomics. Each such handle
+ * is owned by its caller alone.
+ */
+class LUNASVG_API DocumentCache {
+public:
+    /**
+     * @brief Constructs an empty cache.
+     * @param maxBytes The maximum memory held by cached documents.
+     * @param limits The resource limits applied to every document the cache parses.
+     */
+    explicit DocumentCache(size_t maxBytes = 256 * 1024 * 1024, const ResourceLimits& limits = ResourceLimits());
+
+    /**
+     * @brief Drops every cached document. Handles still in use remain valid.
+     */
+    ~DocumentCache();
+
+    /**
+     * @brief Returns the document for the content of a file, parsing it if it is not cached.
+     * @param filename The path to the SVG file.
+     * @return The shared document, or nullptr if the file cannot be read or parsed.
+     */
+    std::shared_ptr<const Document> loadFromFile(const std::string& filename);
+
+    /**
+     * @brief Returns the document for a string, parsing it if it is not cached.
+     * @param string A string containing the SVG content.
+     * @return The shared document, or nullptr if the content cannot be parsed.
+     */
+    std::shared_ptr<const Document> loadFromData(const std::string& string);
+
+    /**
+     * @brief Returns the document for a data buffer, parsing it if it is not cached.
+     * @param data A pointer to the SVG content.
+     * @param length The length of the data in bytes.
+     * @return The shared document, or nullptr if the content cannot be parsed.
+     */
+    std::shared_ptr<const Document> loadFromData(const char* data, size_t length);
+
+    /**
+     * @brief Drops every cached document.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the current counters of the cache.
+     * @return A snapshot of the cache statistics.
+     */
+    DocumentCacheStats stats() const;
+
+private:
+    DocumentCache(const DocumentCache&) = delete;
+    DocumentCache& operator=(const DocumentCache&) = delete;
+    std::unique_ptr<DocumentCacheState> m_state;
 };
 
 } //namespace lunasvg
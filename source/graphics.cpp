@@ -3,6 +3,7 @@
 
 #include <cfloat>
 #include <cmath>
+#include <cstring>
 
 namespace lunasvg {
 
@@ -304,6 +305,13 @@ bool Path::isUnique() const
     return true;
 }
 
+size_t Path::heapSize() const
+{
+    if(m_data)
+        return plutovg_path_get_elements(m_data, nullptr) * sizeof(plutovg_path_element_t);
+    return 0;
+}
+
 bool Path::parse(const char* data, size_t length)
 {
     plutovg_path_reset(ensure());
@@ -586,14 +594,33 @@ void Canvas::strokePath(const Path& path, const StrokeData& strokeData, const Tr
     plutovg_canvas_reset_matrix(m_canvas);
     plutovg_canvas_translate(m_canvas, -m_x, -m_y);
     plutovg_canvas_transform(m_canvas, &transform.matrix());
-    plutovg_canvas_set_line_width(m_canvas, strokeData.lineWidth());
+    auto lineWidth = strokeData.lineWidth();
+    auto coverage = 1.f;
+    if(m_quality == RenderQuality::High) {
+        // Sampling loses coverage on strokes thinner than a pixel, so draw them one pixel wide
+        // with the opacity scaled by the width they actually cover.
+        const auto& matrix = transform.matrix();
+        auto deviceWidth = lineWidth * std::sqrt(std::abs(matrix.a * matrix.d - matrix.b * matrix.c));
+        if(deviceWidth > 0.f && deviceWidth < 1.f) {
+            lineWidth /= deviceWidth;
+            coverage = deviceWidth;
+        }
+    }
+
+    plutovg_canvas_set_line_width(m_canvas, lineWidth);
     plutovg_canvas_set_miter_limit(m_canvas, strokeData.miterLimit());
     plutovg_canvas_set_line_cap(m_canvas, static_cast<plutovg_line_cap_t>(strokeData.lineCap()));
     plutovg_canvas_set_line_join(m_canvas, static_cast<plutovg_line_join_t>(strokeData.lineJoin()));
     plutovg_canvas_set_dash_offset(m_canvas, strokeData.dashOffset());
     plutovg_canvas_set_dash_array(m_canvas, strokeData.dashArray().data(), strokeData.dashArray().size());
     plutovg_canvas_set_operator(m_canvas, PLUTOVG_OPERATOR_SRC_OVER);
-    plutovg_canvas_stroke_path(m_canvas, path.data());
+    if(coverage < 1.f) {
+        plutovg_canvas_set_opacity(m_canvas, coverage);
+        plutovg_canvas_stroke_path(m_canvas, path.data());
+        plutovg_canvas_set_opacity(m_canvas, 1.f);
+    } else {
+        plutovg_canvas_stroke_path(m_canvas, path.data());
+    }
 }
 
 void Canvas::fillText(const std::u32string_view& text, const Font& font, const Point& origin, const Transform& transform)
@@ -715,6 +742,7 @@ Canvas::Canvas(const Bitmap& bitmap)
     : m_surface(plutovg_surface_reference(bitmap.surface()))
     , m_canvas(plutovg_canvas_create(m_surface))
     , m_x(0), m_y(0)
+    , m_quality(RenderQuality::Normal)
 {
 }
 
@@ -722,7 +750,64 @@ Canvas::Canvas(int x, int y, int width, int height)
     : m_surface(plutovg_surface_create(width, height))
     , m_canvas(plutovg_canvas_create(m_surface))
     , m_x(x), m_y(y)
-{
+    , m_quality(RenderQuality::Normal)
+{
+}
+
+uint64_t xxhash64(const void* bytes, size_t length, uint64_t seed)
+{
+    constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+    auto rotl = [](uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); };
+    auto round = [&](uint64_t accumulator, uint64_t input) { return rotl(accumulator + input * kPrime2, 31) * kPrime1; };
+    auto merge = [&](uint64_t hash, uint64_t accumulator) { return (hash ^ round(0, accumulator)) * kPrime1 + kPrime4; };
+    auto read64 = [](const uint8_t* bytes) { uint64_t value; std::memcpy(&value, bytes, sizeof(value)); return value; };
+    auto read32 = [](const uint8_t* bytes) { uint32_t value; std::memcpy(&value, bytes, sizeof(value)); return value; };
+
+    auto data = static_cast<const uint8_t*>(bytes);
+    auto end = data + length;
+    uint64_t hash;
+    if(length >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        do {
+            v1 = round(v1, read64(data));
+            v2 = round(v2, read64(data + 8));
+            v3 = round(v3, read64(data + 16));
+            v4 = round(v4, read64(data + 24));
+            data += 32;
+        } while(end - data >= 32);
+
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = merge(hash, v1);
+        hash = merge(hash, v2);
+        hash = merge(hash, v3);
+        hash = merge(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+
+    hash += length;
+    for(; end - data >= 8; data += 8)
+        hash = rotl(hash ^ round(0, read64(data)), 27) * kPrime1 + kPrime4;
+    if(end - data >= 4) {
+        hash = rotl(hash ^ (read32(data) * kPrime1), 23) * kPrime2 + kPrime3;
+        data += 4;
+    }
+
+    for(; data < end; ++data)
+        hash = rotl(hash ^ (*data * kPrime5), 11) * kPrime1;
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
 }
 
 } // namespace lunasvg
@@ -324,6 +324,25 @@ enum class PathCommand {
     Close = PLUTOVG_PATH_COMMAND_CLOSE
 };
 
+uint64_t xxhash64(const void* data, size_t length, uint64_t seed = 0);
+
+template<typename T>
+inline size_t heapSize(const std::basic_string<T>& value)
+{
+    // Short strings are stored inside the object and own no heap block.
+    auto data = reinterpret_cast<uintptr_t>(value.data());
+    auto object = reinterpret_cast<uintptr_t>(&value);
+    if(data >= object && data < object + sizeof(value))
+        return 0;
+    return (value.capacity() + 1) * sizeof(T);
+}
+
+template<typename T>
+inline size_t heapSize(const std::vector<T>& values)
+{
+    return values.capacity() * sizeof(T);
+}
+
 class Path {
 public:
     Path() = default;
@@ -357,6 +376,7 @@ public:
     bool isEmpty() const;
     bool isUnique() const;
     bool isNull() const { return m_data == nullptr; }
+    size_t heapSize() const;
 
     bool parse(const char* data, size_t length);
 
@@ -502,6 +522,8 @@ using GradientStops = std::vector<GradientStop>;
 
 class Bitmap;
 
+enum class RenderQuality : uint8_t;
+
 class Canvas {
 public:
     static std::shared_ptr<Canvas> create(const Bitmap& bitmap);
@@ -531,6 +553,9 @@ public:
 
     void convertToLuminanceMask();
 
+    RenderQuality quality() const { return m_quality; }
+    void setQuality(RenderQuality quality) { m_quality = quality; }
+
     int x() const { return m_x; }
     int y() const { return m_y; }
     int width() const;
@@ -550,6 +575,7 @@ private:
     plutovg_canvas_t* m_canvas;
     const int m_x;
     const int m_y;
+    RenderQuality m_quality;
 };
 
 } // namespace lunasvg
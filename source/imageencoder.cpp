@@ -0,0 +1,1122 @@
+#include "imageencoder.h"
+
+#include <cassert>
+#include <cstring>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+
+namespace lunasvg {
+
+static inline uint32_t loadPixel(const uint8_t* src, int x)
+{
+    uint32_t pixel;
+    std::memcpy(&pixel, src + x * 4, 4);
+    return pixel;
+}
+
+static inline uint8_t unpremultiply(uint32_t component, uint32_t alpha)
+{
+    if(alpha == 0)
+        return 0;
+    return (component * 255 + alpha / 2) / alpha;
+}
+
+void convertScanline(const uint8_t* src, uint8_t* dst, int width, PixelFormat format)
+{
+    switch(format) {
+    case PixelFormat::ARGB32_Premultiplied:
+        if(src != dst)
+            std::memmove(dst, src, width * 4);
+        break;
+    case PixelFormat::RGBA8888:
+    case PixelFormat::BGRA8888: {
+        int ri = format == PixelFormat::RGBA8888 ? 0 : 2;
+        int bi = format == PixelFormat::RGBA8888 ? 2 : 0;
+        for(int x = 0; x < width; ++x) {
+            auto pixel = loadPixel(src, x);
+            uint32_t a = (pixel >> 24) & 0xFF;
+            uint32_t r = (pixel >> 16) & 0xFF;
+            uint32_t g = (pixel >> 8) & 0xFF;
+            uint32_t b = (pixel >> 0) & 0xFF;
+            if(a != 255) {
+                r = unpremultiply(r, a);
+                g = unpremultiply(g, a);
+                b = unpremultiply(b, a);
+            }
+
+            dst[x * 4 + ri] = r;
+            dst[x * 4 + 1] = g;
+            dst[x * 4 + bi] = b;
+            dst[x * 4 + 3] = a;
+        }
+
+        break;
+    }
+
+    case PixelFormat::RGBA8888_Premultiplied:
+        for(int x = 0; x < width; ++x) {
+            auto pixel = loadPixel(src, x);
+            dst[x * 4 + 0] = (pixel >> 16) & 0xFF;
+            dst[x * 4 + 1] = (pixel >> 8) & 0xFF;
+            dst[x * 4 + 2] = (pixel >> 0) & 0xFF;
+            dst[x * 4 + 3] = (pixel >> 24) & 0xFF;
+        }
+
+        break;
+    case PixelFormat::RGB565:
+        for(int x = 0; x < width; ++x) {
+            auto pixel = loadPixel(src, x);
+            uint16_t value = ((pixel >> 8) & 0xF800) | ((pixel >> 5) & 0x07E0) | ((pixel >> 3) & 0x001F);
+            std::memcpy(dst + x * 2, &value, 2);
+        }
+
+        break;
+    case PixelFormat::A8:
+        for(int x = 0; x < width; ++x)
+            dst[x] = loadPixel(src, x) >> 24;
+        break;
+    default:
+        assert(false);
+    }
+}
+
+static inline void storeBigEndian(uint8_t* dst, uint32_t value)
+{
+    dst[0] = value >> 24;
+    dst[1] = value >> 16;
+    dst[2] = value >> 8;
+    dst[3] = value;
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t length)
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> table;
+        for(uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+
+        return table;
+    }();
+
+    for(size_t i = 0; i < length; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static uint32_t updateAdler32(uint32_t adler, const uint8_t* data, size_t length)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while(length > 0) {
+        auto count = std::min<size_t>(length, 5552);
+        for(size_t i = 0; i < count; ++i) {
+            a += data[i];
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+        data += count;
+        length -= count;
+    }
+
+    return (b << 16) | a;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& output) : m_output(output) {}
+
+    void writeBits(uint32_t value, int count)
+    {
+        m_buffer |= uint64_t(value) << m_count;
+        m_count += count;
+        while(m_count >= 8) {
+            m_output.push_back(m_buffer & 0xFF);
+            m_buffer >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void alignToByte()
+    {
+        if(m_count > 0) {
+            writeBits(0, 8 - m_count);
+        }
+    }
+
+private:
+    std::vector<uint8_t>& m_output;
+    uint64_t m_buffer{0};
+    int m_count{0};
+};
+
+constexpr int kWindowSize = 1 << 15;
+constexpr int kWindowMask = kWindowSize - 1;
+constexpr int kHashBits = 15;
+constexpr int kMinMatch = 3;
+constexpr int kMaxMatch = 258;
+
+struct DeflateLevel {
+    int maxChain;
+    int niceLength;
+    bool lazy;
+};
+
+static const DeflateLevel deflateLevels[] = {
+    {0, 0, false},
+    {4, 8, false},
+    {8, 16, false},
+    {16, 32, false},
+    {16, 32, true},
+    {32, 64, true},
+    {128, 128, true},
+    {256, 258, true},
+    {1024, 258, true},
+    {4096, 258, true}
+};
+
+static const uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static inline int highestBit(uint32_t value)
+{
+    int bit = 0;
+    while(value >>= 1)
+        ++bit;
+    return bit;
+}
+
+static inline int lengthSymbolIndex(int length)
+{
+    int value = length - kMinMatch;
+    if(value < 8)
+        return value;
+    if(length == kMaxMatch)
+        return 28;
+    int bit = highestBit(value);
+    return 4 * (bit - 1) + ((value >> (bit - 2)) & 3);
+}
+
+static inline int distanceSymbol(int distance)
+{
+    int value = distance - 1;
+    if(value < 4)
+        return value;
+    int bit = highestBit(value);
+    return 2 * bit + ((value >> (bit - 1)) & 1);
+}
+
+class FixedHuffmanEncoder {
+public:
+    explicit FixedHuffmanEncoder(BitWriter& writer) : m_writer(writer) {}
+
+    void writeLiteral(int symbol)
+    {
+        const auto& codes = fixedCodes();
+        m_writer.writeBits(codes.literalCodes[symbol], codes.literalLengths[symbol]);
+    }
+
+    void writeMatch(int length, int distance)
+    {
+        const auto& codes = fixedCodes();
+        auto lengthIndex = lengthSymbolIndex(length);
+        writeLiteral(257 + lengthIndex);
+        m_writer.writeBits(length - lengthBase[lengthIndex], lengthExtra[lengthIndex]);
+        auto distanceIndex = distanceSymbol(distance);
+        m_writer.writeBits(codes.distanceCodes[distanceIndex], 5);
+        m_writer.writeBits(distance - distanceBase[distanceIndex], distanceExtra[distanceIndex]);
+    }
+
+private:
+    struct FixedCodes {
+        uint16_t literalCodes[288];
+        uint8_t literalLengths[288];
+        uint16_t distanceCodes[30];
+    };
+
+    static uint32_t reverseBits(uint32_t code, int length)
+    {
+        uint32_t result = 0;
+        for(int i = 0; i < length; ++i) {
+            result = (result << 1) | (code & 1);
+            code >>= 1;
+        }
+
+        return result;
+    }
+
+    static const FixedCodes& fixedCodes()
+    {
+        static const auto codes = [] {
+            FixedCodes codes;
+            for(int symbol = 0; symbol < 288; ++symbol) {
+                uint32_t code;
+                int length;
+                if(symbol < 144) {
+                    code = 0x30 + symbol;
+                    length = 8;
+                } else if(symbol < 256) {
+                    code = 0x190 + symbol - 144;
+                    length = 9;
+                } else if(symbol < 280) {
+                    code = symbol - 256;
+                    length = 7;
+                } else {
+                    code = 0xC0 + symbol - 280;
+                    length = 8;
+                }
+
+                codes.literalCodes[symbol] = reverseBits(code, length);
+                codes.literalLengths[symbol] = length;
+            }
+
+            for(int symbol = 0; symbol < 30; ++symbol)
+                codes.distanceCodes[symbol] = reverseBits(symbol, 5);
+            return codes;
+        }();
+
+        return codes;
+    }
+
+    BitWriter& m_writer;
+};
+
+static inline uint32_t hashBytes(const uint8_t* data)
+{
+    uint32_t value = (data[0] << 16) | (data[1] << 8) | data[2];
+    return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+static void deflateStored(const uint8_t* data, size_t start, size_t end, bool final, BitWriter& writer)
+{
+    do {
+        auto length = std::min<size_t>(end - start, 0xFFFF);
+        bool last = final && start + length == end;
+        writer.writeBits(last ? 1 : 0, 3);
+        writer.alignToByte();
+        writer.writeBits(length, 16);
+        writer.writeBits(~length & 0xFFFF, 16);
+        for(size_t i = 0; i < length; ++i)
+            writer.writeBits(data[start + i], 8);
+        start += length;
+    } while(start < end);
+}
+
+static void deflateFixed(const uint8_t* data, size_t windowStart, size_t start, size_t end, int level, bool final, BitWriter& writer)
+{
+    const auto& params = deflateLevels[level];
+    const auto base = data + windowStart;
+    const auto size = end - windowStart;
+
+    std::vector<int32_t> head(1 << kHashBits, -1);
+    std::vector<int32_t> prev(kWindowSize, -1);
+    auto insert = [&](size_t position) {
+        if(position + kMinMatch > size)
+            return;
+        auto hash = hashBytes(base + position);
+        prev[position & kWindowMask] = head[hash];
+        head[hash] = position;
+    };
+
+    auto findMatch = [&](size_t position, int& distance) {
+        if(position + kMinMatch > size)
+            return 0;
+        int maxLength = std::min<size_t>(kMaxMatch, size - position);
+        int bestLength = kMinMatch - 1;
+        int chain = params.maxChain;
+        auto candidate = head[hashBytes(base + position)];
+        while(candidate >= 0 && chain-- > 0) {
+            auto offset = position - candidate;
+            if(offset > kWindowSize)
+                break;
+            auto a = base + candidate;
+            auto b = base + position;
+            if(a[bestLength] == b[bestLength] && a[0] == b[0]) {
+                int length = 0;
+                while(length < maxLength && a[length] == b[length])
+                    ++length;
+                if(length > bestLength) {
+                    bestLength = length;
+                    distance = offset;
+                    if(length >= params.niceLength || length >= maxLength) {
+                        break;
+                    }
+                }
+            }
+
+            candidate = prev[candidate & kWindowMask];
+        }
+
+        return bestLength >= kMinMatch ? bestLength : 0;
+    };
+
+    for(size_t position = 0; position + windowStart < start; ++position)
+        insert(position);
+    writer.writeBits((final ? 1 : 0) | (1 << 1), 3);
+
+    FixedHuffmanEncoder encoder(writer);
+    size_t position = start - windowStart;
+    while(position < size) {
+        int distance = 0;
+        int length = findMatch(position, distance);
+        insert(position);
+        if(length > 0 && params.lazy && length < params.niceLength) {
+            int nextDistance = 0;
+            if(findMatch(position + 1, nextDistance) > length) {
+                encoder.writeLiteral(base[position]);
+                position += 1;
+                continue;
+            }
+        }
+
+        if(length > 0) {
+            encoder.writeMatch(length, distance);
+            for(int i = 1; i < length; ++i)
+                insert(position + i);
+            position += length;
+        } else {
+            encoder.writeLiteral(base[position]);
+            position += 1;
+        }
+    }
+
+    encoder.writeLiteral(256);
+}
+
+static void deflateRange(const uint8_t* data, size_t windowStart, size_t start, size_t end, int level, bool final, std::vector<uint8_t>& output)
+{
+    BitWriter writer(output);
+    if(level == 0) {
+        deflateStored(data, start, end, final, writer);
+    } else {
+        deflateFixed(data, windowStart, start, end, level, final, writer);
+    }
+
+    if(!final) {
+        writer.writeBits(0, 3);
+        writer.alignToByte();
+        writer.writeBits(0x0000, 16);
+        writer.writeBits(0xFFFF, 16);
+    }
+
+    writer.alignToByte();
+}
+
+static uint8_t paethPredictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if(pa <= pb && pa <= pc)
+        return a;
+    if(pb <= pc)
+        return b;
+    return c;
+}
+
+static void filterScanline(PngFilter filter, const uint8_t* row, const uint8_t* prior, int length, int bpp, uint8_t* output)
+{
+    output[0] = static_cast<uint8_t>(filter);
+    output += 1;
+    switch(filter) {
+    case PngFilter::None:
+        std::memcpy(output, row, length);
+        break;
+    case PngFilter::Sub:
+        for(int i = 0; i < length; ++i)
+            output[i] = row[i] - (i < bpp ? 0 : row[i - bpp]);
+        break;
+    case PngFilter::Up:
+        for(int i = 0; i < length; ++i)
+            output[i] = row[i] - prior[i];
+        break;
+    case PngFilter::Average:
+        for(int i = 0; i < length; ++i)
+            output[i] = row[i] - (((i < bpp ? 0 : row[i - bpp]) + prior[i]) >> 1);
+        break;
+    case PngFilter::Paeth:
+        for(int i = 0; i < length; ++i) {
+            if(i < bpp) {
+                output[i] = row[i] - prior[i];
+            } else {
+                output[i] = row[i] - paethPredictor(row[i - bpp], prior[i], prior[i - bpp]);
+            }
+        }
+
+        break;
+    default:
+        assert(false);
+    }
+}
+
+static uint64_t filterCost(const uint8_t* data, int length)
+{
+    uint64_t cost = 0;
+    for(int i = 0; i < length; ++i)
+        cost += std::abs(static_cast<int8_t>(data[i]));
+    return cost;
+}
+
+enum class PngColorType : uint8_t {
+    Indexed = 3,
+    RGB = 2,
+    RGBA = 6
+};
+
+class PngImageData {
+public:
+    PngImageData(const Bitmap& bitmap, bool palette);
+
+    PngColorType colorType() const { return m_colorType; }
+    int bitDepth() const { return m_bitDepth; }
+    int rowSize() const { return (m_bitmap.width() * m_bitDepth * channels() + 7) / 8; }
+    int channels() const;
+
+    const std::vector<uint32_t>& palette() const { return m_palette; }
+
+    void packScanline(int y, uint8_t* row, uint8_t* rgba) const;
+
+private:
+    const Bitmap& m_bitmap;
+    PngColorType m_colorType{PngColorType::RGBA};
+    int m_bitDepth{8};
+    std::vector<uint32_t> m_palette;
+    std::unordered_map<uint32_t, uint8_t> m_paletteIndices;
+};
+
+static inline uint32_t loadRGBA(const uint8_t* rgba, int x)
+{
+    return (rgba[x * 4] << 24) | (rgba[x * 4 + 1] << 16) | (rgba[x * 4 + 2] << 8) | rgba[x * 4 + 3];
+}
+
+PngImageData::PngImageData(const Bitmap& bitmap, bool palette)
+    : m_bitmap(bitmap)
+{
+    auto width = bitmap.width();
+    auto height = bitmap.height();
+    std::vector<uint8_t> rgba(width * 4);
+    std::unordered_map<uint32_t, uint32_t> colors;
+    bool opaque = true;
+    for(int y = 0; y < height; ++y) {
+        auto row = bitmap.data() + y * bitmap.stride();
+        if(opaque) {
+            for(int x = 0; x < width; ++x) {
+                if((loadPixel(row, x) >> 24) != 0xFF) {
+                    opaque = false;
+                    break;
+                }
+            }
+        }
+
+        if(palette) {
+            convertScanline(row, rgba.data(), width, PixelFormat::RGBA8888);
+            for(int x = 0; x < width && palette; ++x) {
+                colors.emplace(loadRGBA(rgba.data(), x), 0);
+                if(colors.size() > 256) {
+                    palette = false;
+                }
+            }
+        }
+
+        if(!opaque && !palette) {
+            break;
+        }
+    }
+
+    if(palette) {
+        for(const auto& color : colors)
+            m_palette.push_back(color.first);
+        std::stable_sort(m_palette.begin(), m_palette.end(), [](uint32_t a, uint32_t b) {
+            return (a & 0xFF) < (b & 0xFF);
+        });
+
+        for(size_t index = 0; index < m_palette.size(); ++index)
+            m_paletteIndices.emplace(m_palette[index], index);
+        m_colorType = PngColorType::Indexed;
+        if(m_palette.size() <= 2) {
+            m_bitDepth = 1;
+        } else if(m_palette.size() <= 4) {
+            m_bitDepth = 2;
+        } else if(m_palette.size() <= 16) {
+            m_bitDepth = 4;
+        }
+    } else if(opaque) {
+        m_colorType = PngColorType::RGB;
+    }
+}
+
+int PngImageData::channels() const
+{
+    switch(m_colorType) {
+    case PngColorType::Indexed:
+        return 1;
+    case PngColorType::RGB:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+void PngImageData::packScanline(int y, uint8_t* row, uint8_t* rgba) const
+{
+    auto width = m_bitmap.width();
+    convertScanline(m_bitmap.data() + y * m_bitmap.stride(), rgba, width, PixelFormat::RGBA8888);
+    switch(m_colorType) {
+    case PngColorType::RGBA:
+        std::memcpy(row, rgba, width * 4);
+        break;
+    case PngColorType::RGB:
+        for(int x = 0; x < width; ++x) {
+            row[x * 3 + 0] = rgba[x * 4 + 0];
+            row[x * 3 + 1] = rgba[x * 4 + 1];
+            row[x * 3 + 2] = rgba[x * 4 + 2];
+        }
+
+        break;
+    case PngColorType::Indexed: {
+        std::memset(row, 0, rowSize());
+        int pixelsPerByte = 8 / m_bitDepth;
+        for(int x = 0; x < width; ++x) {
+            uint32_t index = m_paletteIndices.at(loadRGBA(rgba, x));
+            int shift = 8 - m_bitDepth * (x % pixelsPerByte + 1);
+            row[x / pixelsPerByte] |= index << shift;
+        }
+
+        break;
+    }
+    }
+}
+
+static void writeChunk(lunasvg_write_func_t callback, void* closure, const char* type, const uint8_t* data, size_t length)
+{
+    uint8_t header[8];
+    storeBigEndian(header, length);
+    std::memcpy(header + 4, type, 4);
+    auto crc = updateCrc(0xFFFFFFFF, header + 4, 4);
+    crc = updateCrc(crc, data, length) ^ 0xFFFFFFFF;
+
+    uint8_t trailer[4];
+    storeBigEndian(trailer, crc);
+    callback(closure, header, 8);
+    if(length > 0)
+        callback(closure, const_cast<uint8_t*>(data), length);
+    callback(closure, trailer, 4);
+}
+
+static void deflateBlocks(const uint8_t* data, size_t start, size_t end, size_t rowSize, int level, int threadCount, bool final, std::vector<std::vector<uint8_t>>& blocks)
+{
+    constexpr size_t kMinBlockSize = 1 << 17;
+    auto rowCount = (end - start) / rowSize;
+    auto blockCount = std::clamp<size_t>((end - start) / kMinBlockSize, 1, std::max<size_t>(1, std::min<size_t>(rowCount, std::max(1, threadCount))));
+    auto rowsPerBlock = (rowCount + blockCount - 1) / blockCount;
+    blocks.resize(blockCount);
+    auto deflateBlock = [&](size_t index) {
+        auto blockStart = start + std::min(index * rowsPerBlock, rowCount) * rowSize;
+        auto blockEnd = index == blockCount - 1 ? end : start + std::min((index + 1) * rowsPerBlock, rowCount) * rowSize;
+        auto windowStart = blockStart > kWindowSize ? blockStart - kWindowSize : 0;
+        blocks[index].clear();
+        deflateRange(data, windowStart, blockStart, blockEnd, level, final && index == blockCount - 1, blocks[index]);
+    };
+
+    if(blockCount == 1) {
+        deflateBlock(0);
+    } else {
+        std::vector<std::thread> threads;
+        for(size_t index = 1; index < blockCount; ++index)
+            threads.emplace_back(deflateBlock, index);
+        deflateBlock(0);
+        for(auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+class PngEncoder {
+public:
+    PngEncoder(int width, int height, PngColorType colorType, int bitDepth, const PngOptions& options, lunasvg_write_func_t callback, void* closure);
+
+    void writeHeader(const std::vector<uint32_t>& palette);
+    int width() const { return m_width; }
+    uint8_t* beginRow() { return m_current.data(); }
+    void endRow();
+    void flush(bool final);
+    void finish();
+
+private:
+    int m_width;
+    int m_height;
+    PngColorType m_colorType;
+    int m_bitDepth;
+    int m_rowSize;
+    int m_bytesPerPixel;
+    int m_level;
+    int m_threadCount;
+    PngFilter m_filter;
+    lunasvg_write_func_t m_callback;
+    void* m_closure;
+    std::vector<uint8_t> m_current;
+    std::vector<uint8_t> m_prior;
+    std::vector<uint8_t> m_candidate;
+    std::vector<uint8_t> m_pending;
+    size_t m_historySize{0};
+    uint32_t m_adler{1};
+};
+
+PngEncoder::PngEncoder(int width, int height, PngColorType colorType, int bitDepth, const PngOptions& options, lunasvg_write_func_t callback, void* closure)
+    : m_width(width), m_height(height), m_colorType(colorType), m_bitDepth(bitDepth)
+    , m_level(std::clamp(options.compressionLevel, 0, 9)), m_threadCount(std::max(1, options.threadCount))
+    , m_filter(options.filter), m_callback(callback), m_closure(closure)
+{
+    int channels = colorType == PngColorType::Indexed ? 1 : colorType == PngColorType::RGB ? 3 : 4;
+    m_rowSize = (width * bitDepth * channels + 7) / 8;
+    m_bytesPerPixel = std::max(1, bitDepth * channels / 8);
+    if(colorType == PngColorType::Indexed && m_filter == PngFilter::Adaptive)
+        m_filter = PngFilter::None;
+    m_current.resize(m_rowSize);
+    m_prior.resize(m_rowSize, 0);
+    m_candidate.resize(m_rowSize + 1);
+}
+
+void PngEncoder::writeHeader(const std::vector<uint32_t>& palette)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    m_callback(m_closure, const_cast<uint8_t*>(signature), 8);
+
+    uint8_t header[13];
+    storeBigEndian(header, m_width);
+    storeBigEndian(header + 4, m_height);
+    header[8] = m_bitDepth;
+    header[9] = static_cast<uint8_t>(m_colorType);
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+    writeChunk(m_callback, m_closure, "IHDR", header, 13);
+
+    if(m_colorType == PngColorType::Indexed) {
+        std::vector<uint8_t> colors;
+        std::vector<uint8_t> alphas;
+        for(auto color : palette) {
+            colors.push_back(color >> 24);
+            colors.push_back(color >> 16);
+            colors.push_back(color >> 8);
+            if((color & 0xFF) != 0xFF) {
+                alphas.push_back(color & 0xFF);
+            }
+        }
+
+        writeChunk(m_callback, m_closure, "PLTE", colors.data(), colors.size());
+        if(!alphas.empty()) {
+            writeChunk(m_callback, m_closure, "tRNS", alphas.data(), alphas.size());
+        }
+    }
+
+    static const uint8_t zlibHeaders[10][2] = {
+        {0x78, 0x01}, {0x78, 0x01}, {0x78, 0x5E}, {0x78, 0x5E}, {0x78, 0x5E},
+        {0x78, 0x5E}, {0x78, 0x9C}, {0x78, 0xDA}, {0x78, 0xDA}, {0x78, 0xDA}
+    };
+
+    writeChunk(m_callback, m_closure, "IDAT", zlibHeaders[m_level], 2);
+}
+
+void PngEncoder::endRow()
+{
+    auto offset = m_pending.size();
+    m_pending.resize(offset + m_rowSize + 1);
+    auto output = m_pending.data() + offset;
+    if(m_filter == PngFilter::Adaptive) {
+        uint64_t bestCost = UINT64_MAX;
+        for(auto type : {PngFilter::None, PngFilter::Sub, PngFilter::Up, PngFilter::Average, PngFilter::Paeth}) {
+            filterScanline(type, m_current.data(), m_prior.data(), m_rowSize, m_bytesPerPixel, m_candidate.data());
+            auto cost = filterCost(m_candidate.data() + 1, m_rowSize);
+            if(cost < bestCost) {
+                bestCost = cost;
+                std::memcpy(output, m_candidate.data(), m_rowSize + 1);
+            }
+        }
+    } else {
+        filterScanline(m_filter, m_current.data(), m_prior.data(), m_rowSize, m_bytesPerPixel, output);
+    }
+
+    m_current.swap(m_prior);
+}
+
+void PngEncoder::flush(bool final)
+{
+    if(!final && m_pending.size() == m_historySize)
+        return;
+    std::vector<std::vector<uint8_t>> blocks;
+    deflateBlocks(m_pending.data(), m_historySize, m_pending.size(), m_rowSize + 1, m_level, m_threadCount, final, blocks);
+    m_adler = updateAdler32(m_adler, m_pending.data() + m_historySize, m_pending.size() - m_historySize);
+    for(const auto& block : blocks) {
+        constexpr size_t kMaxChunkSize = 1 << 20;
+        for(size_t offset = 0; offset < block.size(); offset += kMaxChunkSize) {
+            writeChunk(m_callback, m_closure, "IDAT", block.data() + offset, std::min(kMaxChunkSize, block.size() - offset));
+        }
+    }
+
+    if(m_pending.size() > kWindowSize)
+        m_pending.erase(m_pending.begin(), m_pending.end() - kWindowSize);
+    m_historySize = m_pending.size();
+}
+
+void PngEncoder::finish()
+{
+    flush(true);
+    uint8_t checksum[4];
+    storeBigEndian(checksum, m_adler);
+    writeChunk(m_callback, m_closure, "IDAT", checksum, 4);
+    writeChunk(m_callback, m_closure, "IEND", nullptr, 0);
+}
+
+bool encodePng(const Bitmap& bitmap, const PngOptions& options, lunasvg_write_func_t callback, void* closure)
+{
+    if(bitmap.isNull())
+        return false;
+    PngImageData image(bitmap, options.palette);
+    PngEncoder encoder(bitmap.width(), bitmap.height(), image.colorType(), image.bitDepth(), options, callback, closure);
+    encoder.writeHeader(image.palette());
+
+    std::vector<uint8_t> rgba(bitmap.width() * 4);
+    for(int y = 0; y < bitmap.height(); ++y) {
+        image.packScanline(y, encoder.beginRow(), rgba.data());
+        encoder.endRow();
+    }
+
+    encoder.finish();
+    return true;
+}
+
+class PngStreamEncoderState {
+public:
+    PngStreamEncoderState(int width, int height, const PngOptions& options, lunasvg_write_func_t callback, void* closure)
+        : encoder(width, height, PngColorType::RGBA, 8, options, callback, closure), rowsRemaining(height)
+    {}
+
+    PngEncoder encoder;
+    int rowsRemaining;
+};
+
+PngStreamEncoder::PngStreamEncoder(int width, int height, lunasvg_write_func_t callback, void* closure, const PngOptions& options)
+{
+    if(width > 0 && height > 0) {
+        m_state = std::make_unique<PngStreamEncoderState>(width, height, options, callback, closure);
+        m_state->encoder.writeHeader(std::vector<uint32_t>());
+    }
+}
+
+PngStreamEncoder::~PngStreamEncoder() = default;
+
+bool PngStreamEncoder::writeRows(const Bitmap& rows)
+{
+    if(m_state == nullptr || rows.isNull() || rows.width() != m_state->encoder.width() || rows.height() > m_state->rowsRemaining)
+        return false;
+    auto& encoder = m_state->encoder;
+    for(int y = 0; y < rows.height(); ++y) {
+        convertScanline(rows.data() + y * rows.stride(), encoder.beginRow(), rows.width(), PixelFormat::RGBA8888);
+        encoder.endRow();
+    }
+
+    m_state->rowsRemaining -= rows.height();
+    if(m_state->rowsRemaining > 0)
+        encoder.flush(false);
+    return true;
+}
+
+bool PngStreamEncoder::finish()
+{
+    if(m_state == nullptr || m_state->rowsRemaining > 0)
+        return false;
+    m_state->encoder.finish();
+    m_state.reset();
+    return true;
+}
+
+class QoiEncoder {
+public:
+    QoiEncoder(lunasvg_write_func_t callback, void* closure) : m_callback(callback), m_closure(closure) {}
+
+    void writeHeader(int width, int height);
+    void writePixels(const uint8_t* rgba, int count);
+    void finish();
+
+private:
+    void flushRun();
+    void flushOutput();
+
+    lunasvg_write_func_t m_callback;
+    void* m_closure;
+    std::vector<uint8_t> m_output;
+    uint32_t m_index[64] = {};
+    uint32_t m_previous{0x000000FF};
+    int m_run{0};
+};
+
+void QoiEncoder::writeHeader(int width, int height)
+{
+    uint8_t header[14] = {'q', 'o', 'i', 'f'};
+    storeBigEndian(header + 4, width);
+    storeBigEndian(header + 8, height);
+    header[12] = 4;
+    header[13] = 0;
+    m_callback(m_closure, header, 14);
+}
+
+void QoiEncoder::writePixels(const uint8_t* rgba, int count)
+{
+    for(int i = 0; i < count; ++i) {
+        uint8_t r = rgba[i * 4 + 0];
+        uint8_t g = rgba[i * 4 + 1];
+        uint8_t b = rgba[i * 4 + 2];
+        uint8_t a = rgba[i * 4 + 3];
+        uint32_t pixel = (r << 24) | (g << 16) | (b << 8) | a;
+        if(pixel == m_previous) {
+            if(++m_run == 62)
+                flushRun();
+            continue;
+        }
+
+        flushRun();
+        auto position = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+        if(m_index[position] == pixel) {
+            m_output.push_back(position);
+        } else {
+            m_index[position] = pixel;
+            if(a == (m_previous & 0xFF)) {
+                int8_t vr = r - (m_previous >> 24);
+                int8_t vg = g - ((m_previous >> 16) & 0xFF);
+                int8_t vb = b - ((m_previous >> 8) & 0xFF);
+                int8_t vgr = vr - vg;
+                int8_t vgb = vb - vg;
+                if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    m_output.push_back(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if(vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                    m_output.push_back(0x80 | (vg + 32));
+                    m_output.push_back((vgr + 8) << 4 | (vgb + 8));
+                } else {
+                    m_output.insert(m_output.end(), {0xFE, r, g, b});
+                }
+            } else {
+                m_output.insert(m_output.end(), {0xFF, r, g, b, a});
+            }
+        }
+
+        m_previous = pixel;
+    }
+
+    flushOutput();
+}
+
+void QoiEncoder::finish()
+{
+    flushRun();
+    static const uint8_t padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    m_output.insert(m_output.end(), padding, padding + 8);
+    flushOutput();
+}
+
+void QoiEncoder::flushRun()
+{
+    if(m_run > 0) {
+        m_output.push_back(0xC0 | (m_run - 1));
+        m_run = 0;
+    }
+}
+
+void QoiEncoder::flushOutput()
+{
+    if(!m_output.empty()) {
+        m_callback(m_closure, m_output.data(), m_output.size());
+        m_output.clear();
+    }
+}
+
+bool encodeQoi(const Bitmap& bitmap, PixelFormat format, lunasvg_write_func_t callback, void* closure)
+{
+    if(bitmap.isNull())
+        return false;
+    assert(format == PixelFormat::RGBA8888 || format == PixelFormat::RGBA8888_Premultiplied);
+    auto width = bitmap.width();
+    auto height = bitmap.height();
+    std::vector<uint8_t> rgba(width * 4);
+    QoiEncoder encoder(callback, closure);
+    encoder.writeHeader(width, height);
+    for(int y = 0; y < height; ++y) {
+        convertScanline(bitmap.data() + y * bitmap.stride(), rgba.data(), width, format);
+        encoder.writePixels(rgba.data(), width);
+    }
+
+    encoder.finish();
+    return true;
+}
+
+static inline uint32_t loadBigEndian(const uint8_t* src)
+{
+    return uint32_t(src[0]) << 24 | uint32_t(src[1]) << 16 | uint32_t(src[2]) << 8 | src[3];
+}
+
+Bitmap decodeQoi(const uint8_t* data, size_t length, PixelFormat format)
+{
+    assert(format == PixelFormat::RGBA8888_Premultiplied);
+    constexpr size_t kHeaderSize = 14;
+    constexpr size_t kPaddingSize = 8;
+    if(length < kHeaderSize + kPaddingSize || std::memcmp(data, "qoif", 4) != 0)
+        return Bitmap();
+    auto width = loadBigEndian(data + 4);
+    auto height = loadBigEndian(data + 8);
+    if(width == 0 || height == 0 || width > INT32_MAX / 4 || height > INT32_MAX)
+        return Bitmap();
+    Bitmap bitmap(width, height);
+    if(bitmap.isNull()) {
+        return bitmap;
+    }
+
+    uint8_t index[64][4] = {};
+    uint8_t pixel[4] = {0, 0, 0, 255};
+    auto position = kHeaderSize;
+    auto end = length - kPaddingSize;
+    int run = 0;
+    for(uint32_t y = 0; y < height; ++y) {
+        auto row = reinterpret_cast<uint32_t*>(bitmap.data() + bitmap.stride() * y);
+        for(uint32_t x = 0; x < width; ++x) {
+            if(run > 0) {
+                --run;
+            } else {
+                if(position >= end)
+                    return Bitmap();
+                auto op = data[position++];
+                if(op == 0xFE || op == 0xFF) {
+                    size_t count = op == 0xFE ? 3 : 4;
+                    if(end - position < count)
+                        return Bitmap();
+                    std::memcpy(pixel, data + position, count);
+                    position += count;
+                } else if((op & 0xC0) == 0x00) {
+                    std::memcpy(pixel, index[op], 4);
+                } else if((op & 0xC0) == 0x40) {
+                    pixel[0] += ((op >> 4) & 0x03) - 2;
+                    pixel[1] += ((op >> 2) & 0x03) - 2;
+                    pixel[2] += (op & 0x03) - 2;
+                } else if((op & 0xC0) == 0x80) {
+                    if(position >= end)
+                        return Bitmap();
+                    auto vg = (op & 0x3F) - 32;
+                    auto next = data[position++];
+                    pixel[0] += vg - 8 + ((next >> 4) & 0x0F);
+                    pixel[1] += vg;
+                    pixel[2] += vg - 8 + (next & 0x0F);
+                } else {
+                    run = op & 0x3F;
+                }
+
+                std::memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+            }
+
+            row[x] = uint32_t(pixel[3]) << 24 | uint32_t(pixel[0]) << 16 | uint32_t(pixel[1]) << 8 | pixel[2];
+        }
+    }
+
+    return bitmap;
+}
+
+bool encodePam(const Bitmap& bitmap, lunasvg_write_func_t callback, void* closure)
+{
+    if(bitmap.isNull())
+        return false;
+    auto width = bitmap.width();
+    auto height = bitmap.height();
+    auto header = "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height) + "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    callback(closure, header.data(), header.size());
+
+    std::vector<uint8_t> rgba(width * 4);
+    for(int y = 0; y < height; ++y) {
+        convertScanline(bitmap.data() + y * bitmap.stride(), rgba.data(), width, PixelFormat::RGBA8888);
+        callback(closure, rgba.data(), rgba.size());
+    }
+
+    return true;
+}
+
+bool encodePpm(const Bitmap& bitmap, lunasvg_write_func_t callback, void* closure)
+{
+    if(bitmap.isNull())
+        return false;
+    auto width = bitmap.width();
+    auto height = bitmap.height();
+    auto header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    callback(closure, header.data(), header.size());
+
+    std::vector<uint8_t> rgb(width * 3);
+    for(int y = 0; y < height; ++y) {
+        auto row = bitmap.data() + y * bitmap.stride();
+        for(int x = 0; x < width; ++x) {
+            auto pixel = loadPixel(row, x);
+            rgb[x * 3 + 0] = pixel >> 16;
+            rgb[x * 3 + 1] = pixel >> 8;
+            rgb[x * 3 + 2] = pixel;
+        }
+
+        callback(closure, rgb.data(), rgb.size());
+    }
+
+    return true;
+}
+
+static inline void storeLittleEndian(uint8_t* dst, uint32_t value)
+{
+    dst[0] = value;
+    dst[1] = value >> 8;
+    dst[2] = value >> 16;
+    dst[3] = value >> 24;
+}
+
+bool encodeRaw(const Bitmap& bitmap, lunasvg_write_func_t callback, void* closure)
+{
+    if(bitmap.isNull())
+        return false;
+    auto width = bitmap.width();
+    auto height = bitmap.height();
+    uint8_t header[16] = {'L', 'R', 'A', 'W'};
+    storeLittleEndian(header + 4, width);
+    storeLittleEndian(header + 8, height);
+    storeLittleEndian(header + 12, 0);
+    callback(closure, header, 16);
+
+    std::vector<uint8_t> pixels(width * 4);
+    for(int y = 0; y < height; ++y) {
+        auto row = bitmap.data() + y * bitmap.stride();
+        for(int x = 0; x < width; ++x) {
+            storeLittleEndian(pixels.data() + x * 4, loadPixel(row, x));
+        }
+
+        callback(closure, pixels.data(), pixels.size());
+    }
+
+    return true;
+}
+
+} // namespace lunasvg
@@ -0,0 +1,34 @@
+#ifndef LUNASVG_IMAGEENCODER_H
+#define LUNASVG_IMAGEENCODER_H
+
+#include "lunasvg.h"
+
+#include <fstream>
+
+namespace lunasvg {
+
+void convertScanline(const uint8_t* src, uint8_t* dst, int width, PixelFormat format);
+
+bool encodePng(const Bitmap& bitmap, const PngOptions& options, lunasvg_write_func_t callback, void* closure);
+bool encodeQoi(const Bitmap& bitmap, PixelFormat format, lunasvg_write_func_t callback, void* closure);
+Bitmap decodeQoi(const uint8_t* data, size_t length, PixelFormat format);
+bool encodePam(const Bitmap& bitmap, lunasvg_write_func_t callback, void* closure);
+bool encodePpm(const Bitmap& bitmap, lunasvg_write_func_t callback, void* closure);
+bool encodeRaw(const Bitmap& bitmap, lunasvg_write_func_t callback, void* closure);
+
+template<typename Encoder>
+bool writeToFile(const std::string& filename, Encoder encode)
+{
+    std::ofstream stream(filename, std::ios::binary);
+    if(!stream.is_open())
+        return false;
+    auto callback = [](void* closure, void* data, int size) {
+        static_cast<std::ofstream*>(closure)->write(static_cast<const char*>(data), size);
+    };
+
+    return encode(callback, &stream) && stream.good();
+}
+
+} // namespace lunasvg
+
+#endif // LUNASVG_IMAGEENCODER_H
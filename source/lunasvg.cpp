@@ -1,11 +1,25 @@
 #include "lunasvg.h"
 #include "svgelement.h"
+#include "svggeometryelement.h"
 #include "svglayoutstate.h"
+#include "svgpaintelement.h"
 #include "svgrenderstate.h"
+#include "svgtextelement.h"
+#include "imageencoder.h"
 
 #include <cstring>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 int lunasvg_version()
 {
@@ -39,13 +53,21 @@ Bitmap::Bitmap(uint8_t* data, int width, int height, int stride)
 {
 }
 
+Bitmap::Bitmap(std::shared_ptr<uint8_t> storage, int width, int height, int stride)
+    : m_surface(plutovg_surface_create_for_data(storage.get(), width, height, stride))
+    , m_storage(std::move(storage))
+{
+}
+
 Bitmap::Bitmap(const Bitmap& bitmap)
     : m_surface(plutovg_surface_reference(bitmap.surface()))
+    , m_storage(bitmap.m_storage)
 {
 }
 
 Bitmap::Bitmap(Bitmap&& bitmap)
     : m_surface(bitmap.release())
+    , m_storage(std::move(bitmap.m_storage))
 {
 }
 
@@ -63,6 +85,7 @@ Bitmap& Bitmap::operator=(const Bitmap& bitmap)
 void Bitmap::swap(Bitmap& bitmap)
 {
     std::swap(m_surface, bitmap.m_surface);
+    std::swap(m_storage, bitmap.m_storage);
 }
 
 uint8_t* Bitmap::data() const
@@ -113,6 +136,23 @@ void Bitmap::convertToRGBA()
     plutovg_convert_argb_to_rgba(data, data, width, height, stride);
 }
 
+bool Bitmap::convertTo(const RenderTarget& target) const
+{
+    if(m_surface == nullptr || target.isNull())
+        return false;
+    auto data = plutovg_surface_get_data(m_surface);
+    auto width = plutovg_surface_get_width(m_surface);
+    auto height = plutovg_surface_get_height(m_surface);
+    auto stride = plutovg_surface_get_stride(m_surface);
+    if(width != target.width || height != target.height)
+        return false;
+    for(int y = 0; y < height; ++y) {
+        convertScanline(data + y * stride, target.data + y * target.stride, width, target.format);
+    }
+
+    return true;
+}
+
 Bitmap& Bitmap::operator=(Bitmap&& bitmap)
 {
     Bitmap(std::move(bitmap)).swap(*this);
@@ -133,11 +173,413 @@ bool Bitmap::writeToPng(lunasvg_write_func_t callback, void* closure) const
     return false;
 }
 
+bool Bitmap::writeToPng(const std::string& filename, const PngOptions& options) const
+{
+    return writeToFile(filename, [&](lunasvg_write_func_t callback, void* closure) {
+        return writeToPng(callback, closure, options);
+    });
+}
+
+bool Bitmap::writeToPng(lunasvg_write_func_t callback, void* closure, const PngOptions& options) const
+{
+    return encodePng(*this, options, callback, closure);
+}
+
+bool Bitmap::writeToQoi(const std::string& filename) const
+{
+    return writeToFile(filename, [&](lunasvg_write_func_t callback, void* closure) {
+        return writeToQoi(callback, closure);
+    });
+}
+
+bool Bitmap::writeToQoi(lunasvg_write_func_t callback, void* closure) const
+{
+    return encodeQoi(*this, PixelFormat::RGBA8888, callback, closure);
+}
+
+bool Bitmap::writeToPam(const std::string& filename) const
+{
+    return writeToFile(filename, [&](lunasvg_write_func_t callback, void* closure) {
+        return writeToPam(callback, closure);
+    });
+}
+
+bool Bitmap::writeToPam(lunasvg_write_func_t callback, void* closure) const
+{
+    return encodePam(*this, callback, closure);
+}
+
+bool Bitmap::writeToPpm(const std::string& filename) const
+{
+    return writeToFile(filename, [&](lunasvg_write_func_t callback, void* closure) {
+        return writeToPpm(callback, closure);
+    });
+}
+
+bool Bitmap::writeToPpm(lunasvg_write_func_t callback, void* closure) const
+{
+    return encodePpm(*this, callback, closure);
+}
+
+bool Bitmap::writeToRaw(const std::string& filename) const
+{
+    return writeToFile(filename, [&](lunasvg_write_func_t callback, void* closure) {
+        return writeToRaw(callback, closure);
+    });
+}
+
+bool Bitmap::writeToRaw(lunasvg_write_func_t callback, void* closure) const
+{
+    return encodeRaw(*this, callback, closure);
+}
+
 plutovg_surface_t* Bitmap::release()
 {
     return std::exchange(m_surface, nullptr);
 }
 
+constexpr size_t kCacheLineSize = 64;
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+static size_t storageAlignment(size_t size)
+{
+    return size < kHugePageSize ? kCacheLineSize : kHugePageSize;
+}
+
+static size_t storageCapacity(size_t size)
+{
+    auto alignment = storageAlignment(size);
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static std::shared_ptr<uint8_t> allocateStorage(size_t size)
+{
+    auto alignment = std::align_val_t(storageAlignment(size));
+    auto data = static_cast<uint8_t*>(::operator new(storageCapacity(size), alignment, std::nothrow));
+    if(data == nullptr)
+        return nullptr;
+    return std::shared_ptr<uint8_t>(data, [alignment](uint8_t* data) { ::operator delete(data, alignment); });
+}
+
+class BitmapPoolState {
+public:
+    struct ClearRegion {
+        uint32_t backgroundColor;
+        uint32_t clearPixel;
+        int x0, y0, x1, y1;
+    };
+
+    BitmapPoolState(size_t maxBytes, bool lazyClear)
+        : maxBytes(maxBytes), lazyClear(lazyClear)
+    {}
+
+    Bitmap take(int width, int height, ClearRegion* region);
+
+    std::mutex mutex;
+    std::vector<Bitmap> idleBitmaps;
+    std::unordered_map<const uint8_t*, ClearRegion> clearRegions;
+    size_t idleBytes{0};
+    size_t maxBytes;
+    bool lazyClear;
+    BitmapPoolStats stats;
+};
+
+static size_t bitmapCapacity(const Bitmap& bitmap)
+{
+    return storageCapacity(size_t(bitmap.stride()) * bitmap.height());
+}
+
+Bitmap BitmapPoolState::take(int width, int height, ClearRegion* region)
+{
+    for(auto it = idleBitmaps.begin(); it != idleBitmaps.end(); ++it) {
+        if(it->width() == width && it->height() == height) {
+            auto bitmap = std::move(*it);
+            idleBitmaps.erase(it);
+            idleBytes -= bitmapCapacity(bitmap);
+            stats.reuses++;
+            if(auto found = clearRegions.find(bitmap.data()); found != clearRegions.end()) {
+                if(region) *region = found->second;
+                clearRegions.erase(found);
+            }
+
+            return bitmap;
+        }
+    }
+
+    return Bitmap();
+}
+
+BitmapPool::BitmapPool(size_t maxBytes, bool lazyClear)
+    : m_state(new BitmapPoolState(maxBytes, lazyClear))
+{
+}
+
+BitmapPool::~BitmapPool() = default;
+
+Bitmap BitmapPool::acquire(int width, int height)
+{
+    if(width <= 0 || height <= 0)
+        return Bitmap();
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    if(auto bitmap = m_state->take(width, height, nullptr); !bitmap.isNull())
+        return bitmap;
+    auto stride = width * 4;
+    auto storage = allocateStorage(size_t(stride) * height);
+    if(storage == nullptr)
+        return Bitmap();
+    m_state->clearRegions.erase(storage.get());
+    m_state->stats.allocations++;
+    return Bitmap(std::move(storage), width, height, stride);
+}
+
+Bitmap BitmapPool::acquire(int width, int height, uint32_t backgroundColor, const Box& damageRect)
+{
+    BitmapPoolState::ClearRegion region = { ~backgroundColor, 0, 0, 0, 0, 0 };
+    Bitmap bitmap;
+    if(m_state->lazyClear) {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        bitmap = m_state->take(width, height, &region);
+    }
+
+    if(bitmap.isNull())
+        bitmap = acquire(width, height);
+    if(bitmap.isNull()) {
+        return bitmap;
+    }
+
+    size_t clearedPixels = size_t(width) * height;
+    if(region.backgroundColor == backgroundColor) {
+        clearedPixels = size_t(region.x1 - region.x0) * (region.y1 - region.y0);
+        for(int y = region.y0; y < region.y1; ++y) {
+            auto pixels = reinterpret_cast<uint32_t*>(bitmap.data() + bitmap.stride() * y);
+            std::fill(pixels + region.x0, pixels + region.x1, region.clearPixel);
+        }
+    } else {
+        bitmap.clear(backgroundColor);
+        region.backgroundColor = backgroundColor;
+        region.clearPixel = *reinterpret_cast<const uint32_t*>(bitmap.data());
+    }
+
+    // Antialiasing may touch the pixel just outside the content bounds.
+    region.x0 = std::clamp(static_cast<int>(std::floor(damageRect.x)) - 1, 0, width);
+    region.y0 = std::clamp(static_cast<int>(std::floor(damageRect.y)) - 1, 0, height);
+    region.x1 = std::clamp(static_cast<int>(std::ceil(damageRect.x + damageRect.w)) + 1, region.x0, width);
+    region.y1 = std::clamp(static_cast<int>(std::ceil(damageRect.y + damageRect.h)) + 1, region.y0, height);
+
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->stats.clearedPixels += clearedPixels;
+    m_state->stats.skippedPixels += size_t(width) * height - clearedPixels;
+    if(m_state->lazyClear)
+        m_state->clearRegions[bitmap.data()] = region;
+    return bitmap;
+}
+
+void BitmapPool::release(Bitmap bitmap)
+{
+    if(bitmap.m_storage == nullptr || bitmap.m_storage.use_count() > 1)
+        return;
+    std::vector<Bitmap> evictedBitmaps;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->stats.releases++;
+    m_state->idleBytes += bitmapCapacity(bitmap);
+    m_state->idleBitmaps.push_back(std::move(bitmap));
+    while(m_state->idleBytes > m_state->maxBytes) {
+        auto& evicted = m_state->idleBitmaps.front();
+        m_state->idleBytes -= bitmapCapacity(evicted);
+        m_state->clearRegions.erase(evicted.data());
+        m_state->stats.evictions++;
+        evictedBitmaps.push_back(std::move(evicted));
+        m_state->idleBitmaps.erase(m_state->idleBitmaps.begin());
+    }
+}
+
+void BitmapPool::clear()
+{
+    std::vector<Bitmap> idleBitmaps;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    for(const auto& bitmap : m_state->idleBitmaps)
+        m_state->clearRegions.erase(bitmap.data());
+    idleBitmaps.swap(m_state->idleBitmaps);
+    m_state->idleBytes = 0;
+}
+
+BitmapPoolStats BitmapPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    auto stats = m_state->stats;
+    stats.idleBitmaps = m_state->idleBitmaps.size();
+    stats.idleBytes = m_state->idleBytes;
+    return stats;
+}
+
+class RenderCacheState {
+public:
+    struct Key {
+        uint64_t version;
+        int width;
+        int height;
+        Matrix matrix;
+        uint32_t backgroundColor;
+
+        bool operator==(const Key& key) const;
+        uint64_t hash() const;
+    };
+
+    struct Entry {
+        Key key;
+        size_t bytes;
+        std::shared_ptr<const std::vector<uint8_t>> data;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    RenderCacheState(size_t maxBytes, bool compress)
+        : maxBytes(maxBytes), compress(compress)
+    {}
+
+    Bitmap find(const Key& key);
+    void insert(const Key& key, const Bitmap& bitmap);
+
+    std::mutex mutex;
+    EntryList entries; // Most recently used first.
+    std::unordered_map<uint64_t, EntryList::iterator> index;
+    size_t bytes{0};
+    size_t maxBytes;
+    bool compress;
+    RenderCacheStats stats;
+};
+
+bool RenderCacheState::Key::operator==(const Key& key) const
+{
+    return version == key.version && width == key.width && height == key.height
+        && matrix.a == key.matrix.a && matrix.b == key.matrix.b && matrix.c == key.matrix.c && matrix.d == key.matrix.d
+        && matrix.e == key.matrix.e && matrix.f == key.matrix.f && backgroundColor == key.backgroundColor;
+}
+
+uint64_t RenderCacheState::Key::hash() const
+{
+    const float values[] = { matrix.a, matrix.b, matrix.c, matrix.d, matrix.e, matrix.f };
+    const uint32_t dimensions[] = { uint32_t(width), uint32_t(height), backgroundColor };
+    auto hash = xxhash64(values, sizeof(values), version);
+    return xxhash64(dimensions, sizeof(dimensions), hash);
+}
+
+Bitmap RenderCacheState::find(const Key& key)
+{
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key.hash());
+        if(it == index.end() || !(it->second->key == key)) {
+            stats.misses++;
+            return Bitmap();
+        }
+
+        entries.splice(entries.begin(), entries, it->second);
+        data = it->second->data;
+        stats.hits++;
+    }
+
+    // Decode outside the lock; the entry data stays alive even if it is evicted meanwhile.
+    if(compress)
+        return decodeQoi(data->data(), data->size(), PixelFormat::RGBA8888_Premultiplied);
+    Bitmap bitmap(key.width, key.height);
+    if(!bitmap.isNull()) {
+        auto rowSize = size_t(key.width) * 4;
+        for(int y = 0; y < key.height; ++y) {
+            std::memcpy(bitmap.data() + bitmap.stride() * y, data->data() + rowSize * y, rowSize);
+        }
+    }
+
+    return bitmap;
+}
+
+void RenderCacheState::insert(const Key& key, const Bitmap& bitmap)
+{
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    if(compress) {
+        auto callback = [](void* closure, void* bytes, int size) {
+            auto output = static_cast<std::vector<uint8_t>*>(closure);
+            output->insert(output->end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + size);
+        };
+
+        encodeQoi(bitmap, PixelFormat::RGBA8888_Premultiplied, callback, data.get());
+    } else {
+        auto rowSize = size_t(bitmap.width()) * 4;
+        data->resize(rowSize * bitmap.height());
+        for(int y = 0; y < bitmap.height(); ++y) {
+            std::memcpy(data->data() + rowSize * y, bitmap.data() + bitmap.stride() * y, rowSize);
+        }
+    }
+
+    auto hash = key.hash();
+    EntryList evictedEntries;
+    std::lock_guard<std::mutex> lock(mutex);
+    if(auto it = index.find(hash); it != index.end()) {
+        bytes -= it->second->bytes;
+        evictedEntries.splice(evictedEntries.end(), entries, it->second);
+        index.erase(it);
+    }
+
+    entries.push_front({key, data->size(), std::move(data)});
+    index.emplace(hash, entries.begin());
+    bytes += entries.front().bytes;
+    while(bytes > maxBytes && !entries.empty()) {
+        auto last = std::prev(entries.end());
+        bytes -= last->bytes;
+        index.erase(last->key.hash());
+        stats.evictions++;
+        evictedEntries.splice(evictedEntries.end(), entries, last);
+    }
+}
+
+RenderCache::RenderCache(size_t maxBytes, bool compress)
+    : m_state(new RenderCacheState(maxBytes, compress))
+{
+}
+
+RenderCache::~RenderCache() = default;
+
+void RenderCache::clear()
+{
+    RenderCacheState::EntryList entries;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    entries.swap(m_state->entries);
+    m_state->index.clear();
+    m_state->bytes = 0;
+}
+
+RenderCacheStats RenderCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    auto stats = m_state->stats;
+    stats.entries = m_state->entries.size();
+    stats.bytes = m_state->bytes;
+    return stats;
+}
+
+RenderTarget::RenderTarget(uint8_t* data, int width, int height, int stride, PixelFormat format)
+    : data(data), width(width), height(height), stride(stride), format(format)
+{
+}
+
+int RenderTarget::bytesPerPixel() const
+{
+    switch(format) {
+    case PixelFormat::RGB565:
+        return 2;
+    case PixelFormat::A8:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+bool RenderTarget::isNull() const
+{
+    return data == nullptr || width <= 0 || height <= 0 || stride < width * bytesPerPixel();
+}
+
 Box::Box(float x, float y, float w, float h)
     : x(x), y(y), w(w), h(h)
 {
@@ -280,6 +722,20 @@ Element Node::parentElement() const
     return Element();
 }
 
+Node Node::previousSibling() const
+{
+    if(m_node)
+        return m_node->previousSibling();
+    return Node();
+}
+
+Node Node::nextSibling() const
+{
+    if(m_node)
+        return m_node->nextSibling();
+    return Node();
+}
+
 TextNode::TextNode(SVGTextNode* text)
     : Node(text)
 {
@@ -330,22 +786,209 @@ void Element::setAttribute(const std::string& name, const std::string& value)
     }
 }
 
+static RenderStatus renderElement(const SVGElement* element, const std::shared_ptr<Canvas>& canvas, const Matrix& matrix, const CancellationToken* cancellationToken = nullptr,
+                                  SVGRenderContext::Clock::time_point deadline = SVGRenderContext::Clock::time_point::max())
+{
+    SVGRenderContext context(element->rootElement()->resourceLimits(), cancellationToken, deadline);
+    SVGRenderState state(nullptr, nullptr, matrix, SVGRenderMode::Painting, canvas, &context);
+    SVGStatisticsTimer timer(element->statistics(), &SVGStatistics::renderTime);
+    SVGTraceScope scope("render", element, canvas->extents());
+    element->render(state);
+    return context.status();
+}
+
 void Element::render(Bitmap& bitmap, const Matrix& matrix) const
 {
     if(m_node == nullptr || bitmap.isNull())
         return;
+    renderElement(element(), Canvas::create(bitmap), matrix);
+}
+
+static void blendUpsampled(const Bitmap& source, Bitmap& target)
+{
+    // Bilinear 2x upsampling: per axis, each target pixel takes 3/4 of its nearest source pixel
+    // and 1/4 of the next nearest one. The result is composited over the target.
+    auto sourceWidth = source.width();
+    auto sourceHeight = source.height();
+    for(int y = 0; y < target.height(); ++y) {
+        auto nearY = std::min(y / 2, sourceHeight - 1);
+        auto farY = std::clamp(y % 2 ? nearY + 1 : nearY - 1, 0, sourceHeight - 1);
+        auto nearRow = reinterpret_cast<const uint32_t*>(source.data() + source.stride() * nearY);
+        auto farRow = reinterpret_cast<const uint32_t*>(source.data() + source.stride() * farY);
+        auto row = reinterpret_cast<uint32_t*>(target.data() + target.stride() * y);
+        for(int x = 0; x < target.width(); ++x) {
+            auto nearX = std::min(x / 2, sourceWidth - 1);
+            auto farX = std::clamp(x % 2 ? nearX + 1 : nearX - 1, 0, sourceWidth - 1);
+            uint32_t pixel = 0;
+            for(int shift = 0; shift < 32; shift += 8) {
+                auto value = 9 * ((nearRow[nearX] >> shift) & 0xFF) + 3 * ((nearRow[farX] >> shift) & 0xFF)
+                    + 3 * ((farRow[nearX] >> shift) & 0xFF) + ((farRow[farX] >> shift) & 0xFF);
+                pixel |= ((value + 8) / 16) << shift;
+            }
+
+            auto inverseAlpha = 255 - (pixel >> 24);
+            if(inverseAlpha == 0) {
+                row[x] = pixel;
+            } else if(inverseAlpha < 255) {
+                for(int shift = 0; shift < 32; shift += 8) {
+                    auto channel = (row[x] >> shift) & 0xFF;
+                    pixel += ((channel * inverseAlpha + 127) / 255) << shift;
+                }
+
+                row[x] = pixel;
+            }
+        }
+    }
+}
+
+static RenderStatus renderWithQuality(const SVGElement* element, Bitmap& bitmap, const Matrix& matrix, RenderQuality quality,
+                                      const CancellationToken* cancellationToken, SVGRenderContext::Clock::time_point deadline)
+{
+    if(quality == RenderQuality::Fast && bitmap.width() > 1 && bitmap.height() > 1) {
+        // Previews rasterize a quarter of the pixels and upsample the result.
+        Bitmap preview((bitmap.width() + 1) / 2, (bitmap.height() + 1) / 2);
+        if(!preview.isNull()) {
+            preview.clear(0x00000000);
+            auto status = renderWithQuality(element, preview, Matrix::scaled(0.5f, 0.5f) * matrix, RenderQuality::Normal, cancellationToken, deadline);
+            blendUpsampled(preview, bitmap);
+            return status;
+        }
+    }
+
     auto canvas = Canvas::create(bitmap);
-    SVGRenderState state(nullptr, nullptr, matrix, SVGRenderMode::Painting, canvas);
-    element()->render(state);
+    canvas->setQuality(quality == RenderQuality::High ? quality : RenderQuality::Normal);
+    return renderElement(element, canvas, matrix, cancellationToken, deadline);
 }
 
-Bitmap Element::renderToBitmap(int width, int height, uint32_t backgroundColor) const
+static bool copyPixels(const Bitmap& source, Bitmap& target)
+{
+    if(target.isNull() || target.width() != source.width() || target.height() != source.height())
+        return false;
+    auto rowSize = size_t(source.width()) * 4;
+    for(int y = 0; y < source.height(); ++y) {
+        std::memcpy(target.data() + target.stride() * y, source.data() + source.stride() * y, rowSize);
+    }
+
+    return true;
+}
+
+static RenderStatus renderWithOptions(const SVGElement* element, Bitmap& bitmap, const Matrix& matrix, const RenderOptions& options)
+{
+    if(bitmap.isNull())
+        return RenderStatus::Completed;
+    auto deadline = SVGRenderContext::deadlineAfter(options.timeout);
+    if(options.progressive && options.quality != RenderQuality::Fast) {
+        // The full-quality pass draws over a copy of the original pixels, so the coarse
+        // result stays in the bitmap as the partial result if that pass stops early.
+        Bitmap background(bitmap.width(), bitmap.height());
+        if(copyPixels(bitmap, background)) {
+            auto status = renderWithQuality(element, bitmap, matrix, RenderQuality::Fast, options.cancellationToken, deadline);
+            if(status != RenderStatus::Completed)
+                return status;
+            if(options.progressCallback)
+                options.progressCallback(bitmap);
+            status = renderWithQuality(element, background, matrix, options.quality, options.cancellationToken, deadline);
+            if(status == RenderStatus::Completed)
+                copyPixels(background, bitmap);
+            return status;
+        }
+    }
+
+    return renderWithQuality(element, bitmap, matrix, options.quality, options.cancellationToken, deadline);
+}
+
+RenderStatus Element::render(Bitmap& bitmap, const Matrix& matrix, const RenderOptions& options) const
 {
     if(m_node == nullptr)
-        return Bitmap();
-    auto elementBounds = element()->localTransform().mapRect(element()->paintBoundingBox());
+        return RenderStatus::Completed;
+    return renderWithOptions(element(), bitmap, matrix, options);
+}
+
+static bool hasOpaqueBackground(const SVGElement* element, const Matrix& matrix, int width, int height)
+{
+    auto rootElement = element->rootElement();
+    return element == rootElement && rootElement->hasOpaqueBackground(matrix, Rect(0, 0, width, height));
+}
+
+static RenderStatus renderOverBackground(const SVGElement* element, Bitmap& bitmap, const Matrix& matrix, uint32_t backgroundColor)
+{
+    // The first paint hides the whole background, so clearing would be overwritten anyway.
+    // A render that stops early leaves that paint unfinished, so the background is cleared then.
+    auto opaque = hasOpaqueBackground(element, matrix, bitmap.width(), bitmap.height());
+    if(!opaque)
+        bitmap.clear(backgroundColor);
+    auto status = renderElement(element, Canvas::create(bitmap), matrix);
+    if(opaque && status != RenderStatus::Completed)
+        bitmap.clear(backgroundColor);
+    return status;
+}
+
+static Bitmap renderToPooledBitmap(const SVGElement* element, BitmapPool& pool, int width, int height, const Matrix& matrix, uint32_t backgroundColor, const Box& damageRect)
+{
+    // Pooled bitmaps hold stale pixels, so skipping the clear needs the same guarantee as above.
+    auto opaque = hasOpaqueBackground(element, matrix, width, height);
+    auto bitmap = opaque ? pool.acquire(width, height) : pool.acquire(width, height, backgroundColor, damageRect);
+    if(bitmap.isNull())
+        return bitmap;
+    auto status = renderElement(element, Canvas::create(bitmap), matrix);
+    if(opaque && status != RenderStatus::Completed)
+        bitmap.clear(backgroundColor);
+    return bitmap;
+}
+
+template<typename BandHandler>
+static bool renderBandsOf(const SVGElement* element, int width, int height, int bandHeight, const Matrix& matrix, uint32_t backgroundColor, BandHandler handler)
+{
+    bandHeight = std::clamp(bandHeight, 1, height);
+    Bitmap band(width, bandHeight);
+    if(band.isNull())
+        return false;
+    for(int y = 0; y < height; y += bandHeight) {
+        auto rows = std::min(bandHeight, height - y);
+        auto bitmap = rows == bandHeight ? band : Bitmap(band.data(), width, rows, band.stride());
+        auto bandMatrix = Matrix::translated(0, -y) * matrix;
+        renderOverBackground(element, bitmap, bandMatrix, backgroundColor);
+        if(!handler(bitmap, y)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void renderToTarget(const SVGElement* element, const RenderTarget& target, const Matrix& matrix, uint32_t backgroundColor)
+{
+    if(target.isNull())
+        return;
+    if(target.bytesPerPixel() == 4) {
+        Bitmap bitmap(target.data, target.width, target.height, target.stride);
+        renderOverBackground(element, bitmap, matrix, backgroundColor);
+        bitmap.convertTo(target);
+        return;
+    }
+
+    // Narrower formats are rendered through a bounded 32-bit scratch band, and each band is
+    // converted into its rows of the target as soon as it completes.
+    constexpr int kTargetBandPixels = 1 << 18;
+    auto bandHeight = std::max(1, kTargetBandPixels / target.width);
+    renderBandsOf(element, target.width, target.height, bandHeight, matrix, backgroundColor, [&](const Bitmap& band, int y) {
+        RenderTarget rows(target.data + size_t(target.stride) * y, target.width, band.height(), target.stride, target.format);
+        return band.convertTo(rows);
+    });
+}
+
+void Element::renderToTarget(const RenderTarget& target, const Matrix& matrix, uint32_t backgroundColor) const
+{
+    if(m_node == nullptr)
+        return;
+    lunasvg::renderToTarget(element(), target, matrix, backgroundColor);
+}
+
+static bool resolveRenderMatrix(const SVGElement* element, int& width, int& height, Matrix& matrix)
+{
+    auto elementBounds = element->localTransform().mapRect(element->paintBoundingBox());
     if(elementBounds.isEmpty())
-        return Bitmap();
+        return false;
     if(width <= 0 && height <= 0) {
         width = static_cast<int>(std::ceil(elementBounds.w));
         height = static_cast<int>(std::ceil(elementBounds.h));
@@ -358,13 +1001,29 @@ Bitmap Element::renderToBitmap(int width, int height, uint32_t backgroundColor)
     auto xScale = width / elementBounds.w;
     auto yScale = height / elementBounds.h;
 
-    Matrix matrix(xScale, 0, 0, yScale, -elementBounds.x * xScale, -elementBounds.y * yScale);
+    matrix = Matrix(xScale, 0, 0, yScale, -elementBounds.x * xScale, -elementBounds.y * yScale);
+    return true;
+}
+
+Bitmap Element::renderToBitmap(int width, int height, uint32_t backgroundColor) const
+{
+    Matrix matrix;
+    if(m_node == nullptr || !resolveRenderMatrix(element(), width, height, matrix))
+        return Bitmap();
     Bitmap bitmap(width, height);
-    bitmap.clear(backgroundColor);
-    render(bitmap, matrix);
+    if(!bitmap.isNull())
+        renderOverBackground(element(), bitmap, matrix, backgroundColor);
     return bitmap;
 }
 
+Bitmap Element::renderToBitmap(BitmapPool& pool, int width, int height, uint32_t backgroundColor) const
+{
+    Matrix matrix;
+    if(m_node == nullptr || !resolveRenderMatrix(element(), width, height, matrix))
+        return Bitmap();
+    return renderToPooledBitmap(element(), pool, width, height, matrix, backgroundColor, getLocalBoundingBox().transformed(matrix));
+}
+
 Matrix Element::getLocalMatrix() const
 {
     if(m_node)
@@ -409,12 +1068,36 @@ NodeList Element::children() const
     return children;
 }
 
+NodeRange Element::childNodes() const
+{
+    return NodeRange(firstChild());
+}
+
+Node Element::firstChild() const
+{
+    if(m_node)
+        return element()->firstChild();
+    return Node();
+}
+
+Node Element::lastChild() const
+{
+    if(m_node)
+        return element()->lastChild();
+    return Node();
+}
+
 SVGElement* Element::element() const
 {
     return static_cast<SVGElement*>(m_node);
 }
 
 std::unique_ptr<Document> Document::loadFromFile(const std::string& filename)
+{
+    return loadFromFile(filename, ResourceLimits());
+}
+
+std::unique_ptr<Document> Document::loadFromFile(const std::string& filename, const ResourceLimits& limits)
 {
     std::ifstream fs;
     fs.open(filename);
@@ -423,7 +1106,7 @@ std::unique_ptr<Document> Document::loadFromFile(const std::string& filename)
     std::string content;
     std::getline(fs, content, '\0');
     fs.close();
-    return loadFromData(content);
+    return loadFromData(content, limits);
 }
 
 std::unique_ptr<Document> Document::loadFromData(const std::string& string)
@@ -437,14 +1120,34 @@ std::unique_ptr<Document> Document::loadFromData(const char* data)
 }
 
 std::unique_ptr<Document> Document::loadFromData(const char* data, size_t length)
+{
+    return loadFromData(data, length, ResourceLimits());
+}
+
+std::unique_ptr<Document> Document::loadFromData(const std::string& string, const ResourceLimits& limits)
+{
+    return loadFromData(string.data(), string.size(), limits);
+}
+
+std::unique_ptr<Document> Document::loadFromData(const char* data, size_t length, const ResourceLimits& limits)
 {
     std::unique_ptr<Document> document(new Document);
-    if(!document->parse(data, length))
+    if(!document->parse(data, length, limits))
         return nullptr;
     document->updateLayout();
     return document;
 }
 
+void Document::setResourceLimits(const ResourceLimits& limits)
+{
+    m_rootElement->setResourceLimits(limits);
+}
+
+const ResourceLimits& Document::resourceLimits() const
+{
+    return m_rootElement->resourceLimits();
+}
+
 float Document::width() const
 {
     return m_rootElement->intrinsicWidth();
@@ -462,6 +1165,7 @@ Box Document::boundingBox() const
 
 void Document::updateLayout()
 {
+    SVGStatisticsTimer timer(m_rootElement->statistics(), &SVGStatistics::layoutTime);
     SVGLayoutState state;
     m_rootElement->layout(state);
 }
@@ -470,34 +1174,590 @@ void Document::render(Bitmap& bitmap, const Matrix& matrix) const
 {
     if(bitmap.isNull())
         return;
-    auto canvas = Canvas::create(bitmap);
-    SVGRenderState state(nullptr, nullptr, matrix, SVGRenderMode::Painting, canvas);
-    m_rootElement->render(state);
+    renderElement(m_rootElement.get(), Canvas::create(bitmap), matrix);
 }
 
-Bitmap Document::renderToBitmap(int width, int height, uint32_t backgroundColor) const
+RenderStatus Document::render(Bitmap& bitmap, const Matrix& matrix, const RenderOptions& options) const
 {
-    if(!m_rootElement->intrinsicWidth() || !m_rootElement->intrinsicHeight())
-        return Bitmap();
+    return renderWithOptions(m_rootElement.get(), bitmap, matrix, options);
+}
+
+static Matrix regionMatrix(const Bitmap& bitmap, const Box& sourceRect)
+{
+    auto xScale = bitmap.width() / sourceRect.w;
+    auto yScale = bitmap.height() / sourceRect.h;
+    return Matrix(xScale, 0, 0, yScale, -sourceRect.x * xScale, -sourceRect.y * yScale);
+}
+
+void Document::renderRegion(Bitmap& bitmap, const Box& sourceRect) const
+{
+    if(bitmap.isNull() || sourceRect.w <= 0.f || sourceRect.h <= 0.f)
+        return;
+    render(bitmap, regionMatrix(bitmap, sourceRect));
+}
+
+RenderStatus Document::renderRegion(Bitmap& bitmap, const Box& sourceRect, const RenderOptions& options) const
+{
+    if(bitmap.isNull() || sourceRect.w <= 0.f || sourceRect.h <= 0.f)
+        return RenderStatus::Completed;
+    return render(bitmap, regionMatrix(bitmap, sourceRect), options);
+}
+
+std::vector<Tile> Document::tiles(int zoom) const
+{
+    std::vector<Tile> tiles;
+    auto width = m_rootElement->intrinsicWidth();
+    auto height = m_rootElement->intrinsicHeight();
+    if(zoom < 0 || zoom > 30 || width <= 0.f || height <= 0.f)
+        return tiles;
+    auto tileCount = 1 << zoom;
+    auto tileSize = std::max(width, height) / tileCount;
+    auto columns = std::clamp(static_cast<int>(std::ceil(width / tileSize)), 1, tileCount);
+    auto rows = std::clamp(static_cast<int>(std::ceil(height / tileSize)), 1, tileCount);
+    tiles.reserve(size_t(columns) * rows);
+    for(int y = 0; y < rows; ++y) {
+        for(int x = 0; x < columns; ++x) {
+            tiles.push_back({x, y, zoom, Box(x * tileSize, y * tileSize, tileSize, tileSize)});
+        }
+    }
+
+    return tiles;
+}
+
+void Document::renderToTarget(const RenderTarget& target, const Matrix& matrix, uint32_t backgroundColor) const
+{
+    lunasvg::renderToTarget(m_rootElement.get(), target, matrix, backgroundColor);
+}
+
+static bool resolveRenderSize(const SVGRootElement* rootElement, int& width, int& height)
+{
+    if(!rootElement->intrinsicWidth() || !rootElement->intrinsicHeight())
+        return false;
     if(width <= 0 && height <= 0) {
-        width = static_cast<int>(std::ceil(m_rootElement->intrinsicWidth()));
-        height = static_cast<int>(std::ceil(m_rootElement->intrinsicHeight()));
+        width = static_cast<int>(std::ceil(rootElement->intrinsicWidth()));
+        height = static_cast<int>(std::ceil(rootElement->intrinsicHeight()));
     } else if(width > 0 && height <= 0) {
-        height = static_cast<int>(std::ceil(width * m_rootElement->intrinsicHeight() / m_rootElement->intrinsicWidth()));
+        height = static_cast<int>(std::ceil(width * rootElement->intrinsicHeight() / rootElement->intrinsicWidth()));
     } else if(height > 0 && width <= 0) {
-        width = static_cast<int>(std::ceil(height * m_rootElement->intrinsicWidth() / m_rootElement->intrinsicHeight()));
+        width = static_cast<int>(std::ceil(height * rootElement->intrinsicWidth() / rootElement->intrinsicHeight()));
     }
 
+    return true;
+}
+
+Bitmap Document::renderToBitmap(int width, int height, uint32_t backgroundColor) const
+{
+    if(!resolveRenderSize(m_rootElement.get(), width, height))
+        return Bitmap();
+    auto xScale = width / m_rootElement->intrinsicWidth();
+    auto yScale = height / m_rootElement->intrinsicHeight();
+
+    Matrix matrix(xScale, 0, 0, yScale, 0, 0);
+    Bitmap bitmap(width, height);
+    if(!bitmap.isNull())
+        renderOverBackground(m_rootElement.get(), bitmap, matrix, backgroundColor);
+    return bitmap;
+}
+
+Bitmap Document::renderToBitmap(BitmapPool& pool, int width, int height, uint32_t backgroundColor) const
+{
+    if(!resolveRenderSize(m_rootElement.get(), width, height))
+        return Bitmap();
+    auto xScale = width / m_rootElement->intrinsicWidth();
+    auto yScale = height / m_rootElement->intrinsicHeight();
+
+    Matrix matrix(xScale, 0, 0, yScale, 0, 0);
+    return renderToPooledBitmap(m_rootElement.get(), pool, width, height, matrix, backgroundColor, boundingBox().transformed(matrix));
+}
+
+Bitmap Document::renderToBitmap(RenderCache& cache, int width, int height, uint32_t backgroundColor) const
+{
+    if(!resolveRenderSize(m_rootElement.get(), width, height))
+        return Bitmap();
     auto xScale = width / m_rootElement->intrinsicWidth();
     auto yScale = height / m_rootElement->intrinsicHeight();
 
     Matrix matrix(xScale, 0, 0, yScale, 0, 0);
+    RenderCacheState::Key key = { m_rootElement->version(), width, height, matrix, backgroundColor };
+    if(auto bitmap = cache.m_state->find(key); !bitmap.isNull())
+        return bitmap;
     Bitmap bitmap(width, height);
-    bitmap.clear(backgroundColor);
-    render(bitmap, matrix);
+    if(bitmap.isNull())
+        return bitmap;
+    if(renderOverBackground(m_rootElement.get(), bitmap, matrix, backgroundColor) == RenderStatus::Completed)
+        cache.m_state->insert(key, bitmap);
     return bitmap;
 }
 
+bool Document::renderBands(int width, int height, int bandHeight, const BandCallback& callback, uint32_t backgroundColor) const
+{
+    if(!resolveRenderSize(m_rootElement.get(), width, height))
+        return false;
+    auto xScale = width / m_rootElement->intrinsicWidth();
+    auto yScale = height / m_rootElement->intrinsicHeight();
+
+    Matrix matrix(xScale, 0, 0, yScale, 0, 0);
+    return renderBandsOf(m_rootElement.get(), width, height, bandHeight, matrix, backgroundColor, callback);
+}
+
+static bool prepareConcurrentRender(const SVGElement* element)
+{
+    // Fills the lazily computed bounding box caches so that concurrent renders only read the tree.
+    // Font faces and image surfaces are reference counted by plutovg without atomics, so text and
+    // image content has to stay on one thread.
+    element->paintBoundingBox();
+    auto concurrent = element->id() != ElementID::Text && element->id() != ElementID::Image;
+    for(const auto& child : element->children()) {
+        if(auto childElement = toSVGElement(child); childElement && !prepareConcurrentRender(childElement)) {
+            concurrent = false;
+        }
+    }
+
+    return concurrent;
+}
+
+std::vector<Bitmap> Document::renderBatch(const std::vector<RenderSize>& sizes, uint32_t backgroundColor, int threadCount) const
+{
+    std::vector<Bitmap> bitmaps(sizes.size());
+    std::vector<std::pair<int64_t, size_t>> targets;
+    for(size_t index = 0; index < sizes.size(); ++index) {
+        auto width = sizes[index].width;
+        auto height = sizes[index].height;
+        if(resolveRenderSize(m_rootElement.get(), width, height)) {
+            targets.emplace_back(int64_t(width) * height, index);
+        }
+    }
+
+    // Largest targets first, so the small ones fill in the gaps between threads.
+    std::sort(targets.begin(), targets.end(), std::greater<>());
+    auto renderTarget = [&](size_t index) {
+        const auto& size = sizes[index];
+        bitmaps[index] = renderToBitmap(size.width, size.height, backgroundColor);
+    };
+
+    threadCount = std::min<int64_t>(threadCount, targets.size());
+    if(threadCount <= 1 || !prepareConcurrentRender(m_rootElement.get())) {
+        for(const auto& target : targets)
+            renderTarget(target.second);
+        return bitmaps;
+    }
+
+    std::atomic<size_t> nextTarget(0);
+    auto worker = [&]() {
+        for(auto current = nextTarget++; current < targets.size(); current = nextTarget++) {
+            renderTarget(targets[current].second);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int index = 1; index < threadCount; ++index)
+        threads.emplace_back(worker);
+    worker();
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    return bitmaps;
+}
+
+bool RenderCost::fits(const RenderBudget& budget) const
+{
+    auto withinCap = [](uint64_t value, uint64_t cap) { return cap == 0 || value <= cap; };
+    return withinCap(totalPixels(), budget.maxTotalPixels) && withinCap(peakLayerPixels, budget.maxPeakLayerPixels)
+        && withinCap(pathSegments, budget.maxPathSegments) && withinCap(glyphs, budget.maxGlyphs);
+}
+
+static uint64_t pixelArea(const Rect& rect)
+{
+    if(!rect.isValid() || rect.isEmpty())
+        return 0;
+    return static_cast<uint64_t>(std::ceil(rect.w)) * static_cast<uint64_t>(std::ceil(rect.h));
+}
+
+static uint64_t pathSegmentCount(const Path& path)
+{
+    uint64_t count = 0;
+    for(PathIterator it(path); !it.isDone(); it.next())
+        ++count;
+    return count;
+}
+
+class RenderCostEstimator {
+public:
+    explicit RenderCostEstimator(RenderCost& cost) : m_cost(cost) {}
+
+    void estimateElement(const SVGElement* element, const Transform& transform, const Rect& extents, SVGRenderMode mode);
+    void estimateChildren(const SVGElement* element, const Transform& transform, const Rect& extents, SVGRenderMode mode);
+
+private:
+    void estimateGeometry(const SVGGeometryElement* element, const Transform& transform, const Rect& extents, SVGRenderMode mode);
+    void estimatePaint(const SVGPaintServer& paint, const Transform& transform, const Rect& extents);
+    void estimateResource(const SVGElement* resource, const Transform& transform, const Rect& extents, SVGRenderMode mode);
+    void addCoverage(const Rect& deviceRect, const Rect& extents) { m_cost.coveragePixels += pixelArea(deviceRect.intersected(extents)); }
+    void beginLayer(uint64_t pixels);
+    void endLayer(uint64_t pixels) { m_activePixels -= pixels; }
+
+    RenderCost& m_cost;
+    uint64_t m_activePixels{0};
+    std::vector<const SVGElement*> m_resources;
+};
+
+void RenderCostEstimator::estimateElement(const SVGElement* element, const Transform& transform, const Rect& extents, SVGRenderMode mode)
+{
+    SVGBlendInfo blendInfo(element);
+    auto requiresCompositing = blendInfo.requiresCompositing(mode);
+    auto layerRect = extents;
+    uint64_t layerPixels = 0;
+    if(requiresCompositing) {
+        layerRect = transform.mapRect(element->paintBoundingBox()).intersected(extents);
+        layerPixels = pixelArea(layerRect);
+        m_cost.layers++;
+        m_cost.layerPixels += layerPixels;
+        beginLayer(layerPixels);
+    }
+
+    if(element->isGeometryElement()) {
+        estimateGeometry(static_cast<const SVGGeometryElement*>(element), transform, layerRect, mode);
+    } else if(element->id() == ElementID::Text) {
+        auto textElement = static_cast<const SVGTextElement*>(element);
+        for(const auto& fragment : textElement->fragments()) {
+            if(mode == SVGRenderMode::Clipping || fragment.element->fill().isRenderable())
+                m_cost.glyphs += fragment.length;
+            if(mode == SVGRenderMode::Painting && fragment.element->stroke().isRenderable()) {
+                m_cost.glyphs += fragment.length;
+            }
+        }
+
+        addCoverage(transform.mapRect(textElement->paintBoundingBox()), layerRect);
+    } else if(element->id() == ElementID::Image) {
+        m_cost.images++;
+        addCoverage(transform.mapRect(element->fillBoundingBox()), layerRect);
+    } else {
+        estimateChildren(element, transform, layerRect, mode);
+    }
+
+    if(requiresCompositing) {
+        // The mask canvases have the size of the layer and are alive while it is composited.
+        if(auto clipper = blendInfo.clipper()) {
+            m_cost.clipMasks++;
+            m_cost.clipMaskPixels += layerPixels;
+            beginLayer(layerPixels);
+            estimateResource(clipper, transform * clipper->localTransform(), layerRect, SVGRenderMode::Clipping);
+            endLayer(layerPixels);
+        }
+
+        if(auto masker = blendInfo.masker(); masker && mode == SVGRenderMode::Painting) {
+            m_cost.masks++;
+            m_cost.maskPixels += layerPixels;
+            beginLayer(layerPixels);
+            estimateResource(masker, transform, layerRect, SVGRenderMode::Painting);
+            endLayer(layerPixels);
+        }
+
+        endLayer(layerPixels);
+    }
+}
+
+void RenderCostEstimator::estimateChildren(const SVGElement* element, const Transform& transform, const Rect& extents, SVGRenderMode mode)
+{
+    for(const auto& child : element->children()) {
+        auto childElement = toSVGElement(child);
+        if(childElement == nullptr || childElement->isHiddenElement())
+            continue;
+        auto childTransform = transform * childElement->localTransform();
+        auto boundingBox = childTransform.mapRect(childElement->paintBoundingBox());
+        boundingBox.inflate(1.f);
+        if(!boundingBox.intersected(extents).isEmpty()) {
+            estimateElement(childElement, childTransform, extents, mode);
+        }
+    }
+}
+
+void RenderCostEstimator::estimateGeometry(const SVGGeometryElement* element, const Transform& transform, const Rect& extents, SVGRenderMode mode)
+{
+    if(element->path().isNull() || element->isVisibilityHidden())
+        return;
+    auto segments = pathSegmentCount(element->path());
+    if(mode == SVGRenderMode::Clipping) {
+        m_cost.pathSegments += segments;
+        addCoverage(transform.mapRect(element->fillBoundingBox()), extents);
+        return;
+    }
+
+    if(element->fill().isRenderable()) {
+        m_cost.pathSegments += segments;
+        addCoverage(transform.mapRect(element->fillBoundingBox()), extents);
+        estimatePaint(element->fill(), transform, extents);
+    }
+
+    if(element->stroke().isRenderable()) {
+        m_cost.pathSegments += segments;
+        addCoverage(transform.mapRect(element->strokeBoundingBox()), extents);
+        estimatePaint(element->stroke(), transform, extents);
+    }
+
+    for(const auto& markerPosition : element->markerPositions()) {
+        auto markerElement = markerPosition.element();
+        auto markerTransform = markerElement->markerTransform(markerPosition.origin(), markerPosition.angle(), element->strokeData().lineWidth());
+        m_cost.markers++;
+        estimateResource(markerElement, transform * markerTransform, extents, mode);
+    }
+}
+
+void RenderCostEstimator::estimatePaint(const SVGPaintServer& paint, const Transform& transform, const Rect& extents)
+{
+    auto paintElement = paint.element();
+    if(paintElement == nullptr || paintElement->id() != ElementID::Pattern)
+        return;
+    m_cost.patternTiles++;
+    if(auto patternContentElement = static_cast<const SVGPatternElement*>(paintElement)->patternContentElement()) {
+        estimateResource(patternContentElement, transform, extents, SVGRenderMode::Painting);
+    }
+}
+
+void RenderCostEstimator::estimateResource(const SVGElement* resource, const Transform& transform, const Rect& extents, SVGRenderMode mode)
+{
+    if(std::find(m_resources.begin(), m_resources.end(), resource) != m_resources.end())
+        return;
+    m_resources.push_back(resource);
+    estimateChildren(resource, transform, extents, mode);
+    m_resources.pop_back();
+}
+
+void RenderCostEstimator::beginLayer(uint64_t pixels)
+{
+    m_activePixels += pixels;
+    m_cost.peakLayerPixels = std::max(m_cost.peakLayerPixels, m_activePixels);
+}
+
+RenderCost Document::estimateCost(int width, int height) const
+{
+    RenderCost cost;
+    if(!resolveRenderSize(m_rootElement.get(), width, height))
+        return cost;
+    auto xScale = width / m_rootElement->intrinsicWidth();
+    auto yScale = height / m_rootElement->intrinsicHeight();
+
+    Transform transform(xScale, 0, 0, yScale, 0, 0);
+    RenderCostEstimator estimator(cost);
+    estimator.estimateElement(m_rootElement.get(), transform * m_rootElement->localTransform(), Rect(0, 0, width, height), SVGRenderMode::Painting);
+    return cost;
+}
+
+class MemoryUsageCounter {
+public:
+    explicit MemoryUsageCounter(MemoryUsage& usage) : m_usage(usage) {}
+
+    void countNode(const SVGNode* node);
+
+private:
+    void countElement(const SVGElement* element);
+    size_t pathSize(const Path& path);
+
+    MemoryUsage& m_usage;
+    std::unordered_set<const plutovg_path_t*> m_paths;
+};
+
+static size_t elementObjectSize(ElementID id)
+{
+    switch(id) {
+    case ElementID::Svg:
+        return sizeof(SVGSVGElement);
+    case ElementID::Path:
+        return sizeof(SVGPathElement);
+    case ElementID::G:
+        return sizeof(SVGGElement);
+    case ElementID::Rect:
+        return sizeof(SVGRectElement);
+    case ElementID::Circle:
+        return sizeof(SVGCircleElement);
+    case ElementID::Ellipse:
+        return sizeof(SVGEllipseElement);
+    case ElementID::Line:
+        return sizeof(SVGLineElement);
+    case ElementID::Defs:
+        return sizeof(SVGDefsElement);
+    case ElementID::Polygon:
+    case ElementID::Polyline:
+        return sizeof(SVGPolyElement);
+    case ElementID::Stop:
+        return sizeof(SVGStopElement);
+    case ElementID::LinearGradient:
+        return sizeof(SVGLinearGradientElement);
+    case ElementID::RadialGradient:
+        return sizeof(SVGRadialGradientElement);
+    case ElementID::Symbol:
+        return sizeof(SVGSymbolElement);
+    case ElementID::Use:
+        return sizeof(SVGUseElement);
+    case ElementID::Pattern:
+        return sizeof(SVGPatternElement);
+    case ElementID::Mask:
+        return sizeof(SVGMaskElement);
+    case ElementID::ClipPath:
+        return sizeof(SVGClipPathElement);
+    case ElementID::Marker:
+        return sizeof(SVGMarkerElement);
+    case ElementID::Image:
+        return sizeof(SVGImageElement);
+    case ElementID::Style:
+        return sizeof(SVGStyleElement);
+    case ElementID::Text:
+        return sizeof(SVGTextElement);
+    case ElementID::Tspan:
+        return sizeof(SVGTSpanElement);
+    default:
+        return sizeof(SVGElement);
+    }
+}
+
+void MemoryUsageCounter::countNode(const SVGNode* node)
+{
+    if(auto element = toSVGElement(node)) {
+        countElement(element);
+    } else {
+        auto textNode = static_cast<const SVGTextNode*>(node);
+        m_usage.nodes += sizeof(SVGTextNode);
+        m_usage.text += heapSize(textNode->data());
+    }
+}
+
+void MemoryUsageCounter::countElement(const SVGElement* element)
+{
+    // A node of std::list holds the two links and the owning pointer.
+    constexpr size_t kChildLinkSize = 2 * sizeof(void*) + sizeof(std::unique_ptr<SVGNode>);
+    // A node of std::forward_list holds the next link ahead of the value.
+    constexpr size_t kForwardLinkSize = sizeof(void*);
+    m_usage.nodes += element == element->rootElement() ? sizeof(SVGRootElement) : elementObjectSize(element->id());
+    for(const auto& attribute : element->attributes())
+        m_usage.attributes += kForwardLinkSize + sizeof(Attribute) + heapSize(attribute.value());
+    m_usage.attributes += heapSize(element->classNames());
+    for(const auto& name : element->classNames())
+        m_usage.attributes += heapSize(name);
+    for(const auto* property : element->properties()) {
+        m_usage.properties += kForwardLinkSize + sizeof(SVGProperty*);
+        if(property->id() == PropertyID::D) {
+            m_usage.paths += pathSize(static_cast<const SVGPath*>(property)->value());
+        } else {
+            m_usage.properties += property->heapSize();
+        }
+    }
+
+    if(element->isGeometryElement()) {
+        auto geometryElement = static_cast<const SVGGeometryElement*>(element);
+        m_usage.paths += pathSize(geometryElement->path()) + heapSize(geometryElement->markerPositions());
+        m_usage.properties += heapSize(geometryElement->strokeData().dashArray());
+    } else if(element->id() == ElementID::Text) {
+        auto textElement = static_cast<const SVGTextElement*>(element);
+        m_usage.text += heapSize(textElement->text()) + heapSize(textElement->fragments());
+    } else if(element->id() == ElementID::Image) {
+        const auto& image = static_cast<const SVGImageElement*>(element)->image();
+        m_usage.images += size_t(image.height()) * image.stride();
+    }
+
+    if(element->id() == ElementID::Use) {
+        // Children of a <use> element are always the clone of its target.
+        MemoryUsage cloneUsage;
+        MemoryUsageCounter counter(cloneUsage);
+        counter.m_paths.swap(m_paths);
+        for(const auto& child : element->children()) {
+            cloneUsage.nodes += kChildLinkSize;
+            counter.countNode(child.get());
+        }
+
+        m_paths.swap(counter.m_paths);
+        m_usage.useClones += cloneUsage.total();
+        return;
+    }
+
+    for(const auto& child : element->children()) {
+        m_usage.nodes += kChildLinkSize;
+        countNode(child.get());
+    }
+}
+
+size_t MemoryUsageCounter::pathSize(const Path& path)
+{
+    // Geometry elements share the path data parsed from their d attribute.
+    if(path.isNull() || !m_paths.insert(path.data()).second)
+        return 0;
+    return path.heapSize();
+}
+
+MemoryUsage Document::memoryUsage() const
+{
+    MemoryUsage usage;
+    MemoryUsageCounter counter(usage);
+    counter.countNode(m_rootElement.get());
+    usage.idCache = m_rootElement->idCacheHeapSize() + m_rootElement->classIndexHeapSize();
+    return usage;
+}
+
+void Document::setStatisticsEnabled(bool enabled)
+{
+    m_rootElement->setStatisticsEnabled(enabled);
+}
+
+bool Document::isStatisticsEnabled() const
+{
+    return m_rootElement->statistics() != nullptr;
+}
+
+static double toMilliseconds(const std::atomic<uint64_t>& nanoseconds)
+{
+    return nanoseconds.load(std::memory_order_relaxed) / 1e6;
+}
+
+DocumentStatistics Document::statistics() const
+{
+    auto statistics = m_loadStatistics;
+    if(auto counters = m_rootElement->statistics()) {
+        statistics.layoutTime = toMilliseconds(counters->layoutTime);
+        statistics.renderTime = toMilliseconds(counters->renderTime);
+        statistics.layersAllocated = counters->layersAllocated.load(std::memory_order_relaxed);
+        statistics.layerPixels = counters->layerPixels.load(std::memory_order_relaxed);
+        statistics.maskRenders = counters->maskRenders.load(std::memory_order_relaxed);
+        statistics.clipMaskRenders = counters->clipMaskRenders.load(std::memory_order_relaxed);
+        statistics.gradientResolutions = counters->gradientResolutions.load(std::memory_order_relaxed);
+        statistics.patternResolutions = counters->patternResolutions.load(std::memory_order_relaxed);
+        statistics.imageDecodes = counters->imageDecodes.load(std::memory_order_relaxed);
+        statistics.glyphsDrawn = counters->glyphsDrawn.load(std::memory_order_relaxed);
+    }
+
+    return statistics;
+}
+
+void Document::resetStatistics()
+{
+    m_loadStatistics = DocumentStatistics();
+    if(isStatisticsEnabled()) {
+        m_rootElement->setStatisticsEnabled(false);
+        m_rootElement->setStatisticsEnabled(true);
+    }
+}
+
+void Document::setTracingEnabled(bool enabled)
+{
+    m_rootElement->setTracingEnabled(enabled);
+}
+
+bool Document::isTracingEnabled() const
+{
+    return m_rootElement->tracer() != nullptr;
+}
+
+std::string Document::exportTrace() const
+{
+    if(auto tracer = m_rootElement->tracer())
+        return tracer->exportJson();
+    return std::string();
+}
+
+void Document::clearTrace()
+{
+    m_rootElement->clearTrace();
+}
+
 Element Document::getElementById(const std::string& id) const
 {
     return m_rootElement->getElementById(id);
@@ -514,4 +1774,272 @@ Document& Document::operator=(Document&&) = default;
 Document::Document() = default;
 Document::~Document() = default;
 
+static const SVGElement* damageElement(const SVGElement* element)
+{
+    // Clip paths and masks in object bounding box units depend on the bounds of the element
+    // they apply to, so a change inside such an element can repaint all of it.
+    auto damageElement = element;
+    for(auto parent = element->parent(); parent; parent = parent->parent()) {
+        if(parent->clipper() || parent->masker()) {
+            damageElement = parent;
+        }
+    }
+
+    return damageElement;
+}
+
+static Rect deviceBoundingBox(const SVGElement* element, const Matrix& matrix)
+{
+    auto transform = element->localTransform();
+    for(auto parent = element->parent(); parent; parent = parent->parent())
+        transform.postMultiply(parent->localTransform());
+    transform.postMultiply(matrix);
+    auto boundingBox = element->paintBoundingBox();
+    if(boundingBox.isEmpty())
+        return Rect::Invalid;
+    return transform.mapRect(boundingBox);
+}
+
+static SVGElement* layoutRoot(SVGElement* element)
+{
+    // Text is laid out as a whole by its outermost text element, and content referenced from
+    // elsewhere may change any element that uses it.
+    if(element->parent() == nullptr || element->isHiddenElement())
+        return nullptr;
+    for(auto parent = element->parent(); parent; parent = parent->parent()) {
+        if(parent->isHiddenElement())
+            return nullptr;
+        if(parent->id() == ElementID::Text) {
+            element = parent;
+        }
+    }
+
+    return element;
+}
+
+static void relayoutElement(SVGElement* element)
+{
+    std::vector<SVGElement*> ancestors;
+    for(auto parent = element->parent(); parent; parent = parent->parent())
+        ancestors.push_back(parent);
+    std::deque<SVGLayoutState> states(1);
+    for(auto it = ancestors.rbegin(); it != ancestors.rend(); ++it)
+        states.emplace_back(states.back(), *it);
+    element->layout(states.back());
+    for(auto ancestor : ancestors) {
+        ancestor->invalidatePaintBoundingBox();
+    }
+}
+
+FrameRenderer::FrameRenderer(Document& document, int width, int height, uint32_t backgroundColor)
+    : m_document(&document)
+    , m_backgroundColor(backgroundColor)
+{
+    if(resolveRenderSize(document.rootElement(), width, height)) {
+        m_bitmap = Bitmap(width, height);
+    }
+}
+
+void FrameRenderer::setAttribute(const Element& element, const std::string& name, const std::string& value)
+{
+    if(!element.isNull()) {
+        m_changes.push_back({element, name, value});
+    }
+}
+
+const Bitmap& FrameRenderer::renderFrame()
+{
+    using Clock = std::chrono::steady_clock;
+    auto layoutStart = Clock::now();
+    auto rootElement = m_document->rootElement();
+    Matrix matrix;
+    if(!m_bitmap.isNull()) {
+        matrix = Matrix::scaled(m_bitmap.width() / rootElement->intrinsicWidth(), m_bitmap.height() / rootElement->intrinsicHeight());
+    }
+
+    m_stats = FrameStats();
+    m_stats.changedElements = m_changes.size();
+
+    Rect damageRect = Rect::Invalid;
+    std::vector<SVGElement*> layoutRoots;
+    for(const auto& change : m_changes) {
+        auto element = layoutRoot(change.element.element());
+        if(element == nullptr || change.name == "id")
+            m_stats.fullLayout = true;
+        if(!m_stats.fullLayout) {
+            damageRect.unite(deviceBoundingBox(damageElement(element), matrix));
+            layoutRoots.push_back(element);
+        }
+
+        change.element.element()->setAttribute(change.name, change.value);
+    }
+
+    m_changes.clear();
+    if(m_stats.fullLayout) {
+        m_document->updateLayout();
+        m_fullRedraw = true;
+    } else {
+        for(auto element : layoutRoots)
+            relayoutElement(element);
+        for(auto element : layoutRoots) {
+            damageRect.unite(deviceBoundingBox(damageElement(element), matrix));
+        }
+    }
+
+    auto renderStart = Clock::now();
+    if(m_fullRedraw) {
+        damageRect = Rect(0, 0, m_bitmap.width(), m_bitmap.height());
+        m_fullRedraw = false;
+    }
+
+    if(damageRect.isValid() && !m_bitmap.isNull()) {
+        // Antialiasing may touch the pixel just outside the content bounds.
+        auto x0 = std::clamp(static_cast<int>(std::floor(damageRect.x)) - 1, 0, m_bitmap.width());
+        auto y0 = std::clamp(static_cast<int>(std::floor(damageRect.y)) - 1, 0, m_bitmap.height());
+        auto x1 = std::clamp(static_cast<int>(std::ceil(damageRect.right())) + 1, x0, m_bitmap.width());
+        auto y1 = std::clamp(static_cast<int>(std::ceil(damageRect.bottom())) + 1, y0, m_bitmap.height());
+        if(x0 < x1 && y0 < y1) {
+            Bitmap region(m_bitmap.data() + m_bitmap.stride() * y0 + x0 * 4, x1 - x0, y1 - y0, m_bitmap.stride());
+            region.clear(m_backgroundColor);
+            m_document->render(region, Matrix::translated(-x0, -y0) * matrix);
+            m_stats.damageRect = Box(x0, y0, x1 - x0, y1 - y0);
+        }
+    }
+
+    auto renderEnd = Clock::now();
+    m_stats.layoutTime = std::chrono::duration<double, std::milli>(renderStart - layoutStart).count();
+    m_stats.renderTime = std::chrono::duration<double, std::milli>(renderEnd - renderStart).count();
+    return m_bitmap;
+}
+
+class DocumentCacheState {
+public:
+    struct Entry {
+        uint64_t hash;
+        std::string content;
+        size_t bytes;
+        std::shared_ptr<const Document> document;
+
+        bool matches(const char* data, size_t length) const { return content.size() == length && std::memcmp(content.data(), data, length) == 0; }
+    };
+
+    using EntryList = std::list<Entry>;
+
+    DocumentCacheState(size_t maxBytes, const ResourceLimits& limits)
+        : maxBytes(maxBytes), limits(limits)
+    {}
+
+    void evict(std::vector<std::shared_ptr<const Document>>& evictedDocuments);
+
+    std::mutex mutex;
+    EntryList entries; // Most recently used first.
+    std::unordered_map<uint64_t, EntryList::iterator> index;
+    size_t bytes{0};
+    size_t maxBytes;
+    ResourceLimits limits;
+    DocumentCacheStats stats;
+};
+
+void DocumentCacheState::evict(std::vector<std::shared_ptr<const Document>>& evictedDocuments)
+{
+    while(bytes > maxBytes && !entries.empty()) {
+        auto& entry = entries.back();
+        bytes -= entry.bytes;
+        index.erase(entry.hash);
+        stats.evictions++;
+        evictedDocuments.push_back(std::move(entry.document));
+        entries.pop_back();
+    }
+}
+
+DocumentCache::DocumentCache(size_t maxBytes, const ResourceLimits& limits)
+    : m_state(new DocumentCacheState(maxBytes, limits))
+{
+}
+
+DocumentCache::~DocumentCache() = default;
+
+std::shared_ptr<const Document> DocumentCache::loadFromFile(const std::string& filename)
+{
+    std::ifstream fs;
+    fs.open(filename);
+    if(!fs.is_open())
+        return nullptr;
+    std::string content;
+    std::getline(fs, content, '\0');
+    fs.close();
+    return loadFromData(content);
+}
+
+std::shared_ptr<const Document> DocumentCache::loadFromData(const std::string& string)
+{
+    return loadFromData(string.data(), string.size());
+}
+
+std::shared_ptr<const Document> DocumentCache::loadFromData(const char* data, size_t length)
+{
+    auto hash = xxhash64(data, length);
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        auto it = m_state->index.find(hash);
+        if(it != m_state->index.end() && it->second->matches(data, length)) {
+            m_state->entries.splice(m_state->entries.begin(), m_state->entries, it->second);
+            m_state->stats.hits++;
+            return it->second->document;
+        }
+
+        m_state->stats.misses++;
+    }
+
+    // Parse without holding the lock, so loads of other content proceed meanwhile.
+    std::shared_ptr<const Document> document(Document::loadFromData(data, length, m_state->limits));
+    if(document == nullptr)
+        return nullptr;
+    // Fills the lazily computed bounding boxes now, so that renders of a shared handle only read the tree.
+    // Font faces and image surfaces cannot be shared between threads, so such documents are never cached.
+    if(!prepareConcurrentRender(document->rootElement()))
+        return document;
+    auto bytes = document->memoryUsage().total() + length;
+
+    std::vector<std::shared_ptr<const Document>> evictedDocuments;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    auto it = m_state->index.find(hash);
+    if(it != m_state->index.end()) {
+        // Another thread parsed the same content first; hand out its copy.
+        if(it->second->matches(data, length)) {
+            m_state->entries.splice(m_state->entries.begin(), m_state->entries, it->second);
+            return it->second->document;
+        }
+
+        m_state->bytes -= it->second->bytes;
+        evictedDocuments.push_back(std::move(it->second->document));
+        m_state->entries.erase(it->second);
+        m_state->index.erase(it);
+    }
+
+    m_state->entries.push_front({hash, std::string(data, length), bytes, document});
+    m_state->index.emplace(hash, m_state->entries.begin());
+    m_state->bytes += bytes;
+    m_state->evict(evictedDocuments);
+    return document;
+}
+
+void DocumentCache::clear()
+{
+    DocumentCacheState::EntryList entries;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    entries.swap(m_state->entries);
+    m_state->index.clear();
+    m_state->bytes = 0;
+}
+
+DocumentCacheStats DocumentCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    auto stats = m_state->stats;
+    stats.documents = m_state->entries.size();
+    stats.bytes = m_state->bytes;
+    return stats;
+}
+
 } // namespace lunasvg
@@ -5,8 +5,10 @@
 #include "svgproperty.h"
 #include "svglayoutstate.h"
 #include "svgrenderstate.h"
+#include "svgparserutils.h"
 
 #include <cassert>
+#include <cstdio>
 
 namespace lunasvg {
 
@@ -15,6 +17,168 @@ SVGRootElement* SVGNode::rootElement() const
     return document()->rootElement();
 }
 
+SVGStatistics* SVGNode::statistics() const
+{
+    return rootElement()->statistics();
+}
+
+SVGTracer* SVGNode::tracer() const
+{
+    return rootElement()->tracer();
+}
+
+static std::atomic<uint64_t> tracerSerial(0);
+
+SVGTracer::SVGTracer()
+    : m_serial(++tracerSerial)
+    , m_epoch(std::chrono::steady_clock::now())
+{
+}
+
+SVGTracer::ThreadBuffer* SVGTracer::threadBuffer()
+{
+    thread_local uint64_t cachedSerial = 0;
+    thread_local ThreadBuffer* cachedBuffer = nullptr;
+    if(cachedSerial == m_serial)
+        return cachedBuffer;
+    // The tracer lock is only taken when a thread first meets this tracer. After that, events are
+    // appended under the lock of the thread's own buffer, which only an export in progress contends for.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto threadId = std::this_thread::get_id();
+    ThreadBuffer* threadBuffer = nullptr;
+    for(const auto& buffer : m_buffers) {
+        if(buffer->threadId == threadId) {
+            threadBuffer = buffer.get();
+            break;
+        }
+    }
+
+    if(threadBuffer == nullptr) {
+        m_buffers.push_back(std::make_unique<ThreadBuffer>());
+        threadBuffer = m_buffers.back().get();
+        threadBuffer->threadId = threadId;
+    }
+
+    cachedSerial = m_serial;
+    cachedBuffer = threadBuffer;
+    return threadBuffer;
+}
+
+uint64_t SVGTracer::now() const
+{
+    auto elapsed = std::chrono::steady_clock::now() - m_epoch;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+static void appendJsonString(std::string& output, const std::string_view& value)
+{
+    output += '"';
+    for(auto cc : value) {
+        if(cc == '"' || cc == '\\') {
+            output += '\\';
+            output += cc;
+        } else if(static_cast<unsigned char>(cc) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", cc);
+            output += buffer;
+        } else {
+            output += cc;
+        }
+    }
+
+    output += '"';
+}
+
+std::string SVGTracer::exportJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string output("{\"traceEvents\":[");
+    char buffer[256];
+    bool first = true;
+    for(size_t index = 0; index < m_buffers.size(); ++index) {
+        std::lock_guard<std::mutex> bufferLock(m_buffers[index]->mutex);
+        for(const auto& event : m_buffers[index]->events) {
+            if(!first)
+                output += ',';
+            first = false;
+            std::string name(event.name);
+            name += ' ';
+            name += event.tag;
+            if(!event.id.empty()) {
+                name += '#';
+                name += event.id;
+            }
+
+            output += "\n{\"name\":";
+            appendJsonString(output, name);
+            std::snprintf(buffer, sizeof(buffer), ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%zu,\"args\":{\"tag\":\"%s\",\"id\":",
+                event.name, event.start / 1e3, event.duration / 1e3, index + 1, event.tag);
+            output += buffer;
+            appendJsonString(output, event.id);
+            const auto& box = event.boundingBox;
+            std::snprintf(buffer, sizeof(buffer), ",\"bbox\":[%g,%g,%g,%g]}}", box.x, box.y, box.w, box.h);
+            output += buffer;
+        }
+    }
+
+    output += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return output;
+}
+
+const char* elementname(ElementID id)
+{
+    switch(id) {
+    case ElementID::Circle:
+        return "circle";
+    case ElementID::ClipPath:
+        return "clipPath";
+    case ElementID::Defs:
+        return "defs";
+    case ElementID::Ellipse:
+        return "ellipse";
+    case ElementID::G:
+        return "g";
+    case ElementID::Image:
+        return "image";
+    case ElementID::Line:
+        return "line";
+    case ElementID::LinearGradient:
+        return "linearGradient";
+    case ElementID::Marker:
+        return "marker";
+    case ElementID::Mask:
+        return "mask";
+    case ElementID::Path:
+        return "path";
+    case ElementID::Pattern:
+        return "pattern";
+    case ElementID::Polygon:
+        return "polygon";
+    case ElementID::Polyline:
+        return "polyline";
+    case ElementID::RadialGradient:
+        return "radialGradient";
+    case ElementID::Rect:
+        return "rect";
+    case ElementID::Stop:
+        return "stop";
+    case ElementID::Style:
+        return "style";
+    case ElementID::Svg:
+        return "svg";
+    case ElementID::Symbol:
+        return "symbol";
+    case ElementID::Text:
+        return "text";
+    case ElementID::Tspan:
+        return "tspan";
+    case ElementID::Use:
+        return "use";
+    default:
+        return "unknown";
+    }
+}
+
 ElementID elementid(const std::string_view& name)
 {
     static const struct {
@@ -58,6 +222,12 @@ SVGTextNode::SVGTextNode(Document* document)
 {
 }
 
+void SVGTextNode::setData(const std::string& data)
+{
+    m_data = data;
+    rootElement()->updateVersion();
+}
+
 std::unique_ptr<SVGNode> SVGTextNode::clone(bool deep) const
 {
     auto node = std::make_unique<SVGTextNode>(document());
@@ -191,12 +361,14 @@ bool SVGElement::setAttribute(int specificity, PropertyID id, const std::string&
                 return false;
             parseAttribute(id, value);
             attribute = Attribute(specificity, id, value);
+            rootElement()->updateVersion();
             return true;
         }
     }
 
     parseAttribute(id, value);
     m_attributes.emplace_front(specificity, id, value);
+    rootElement()->updateVersion();
     return true;
 }
 
@@ -214,54 +386,61 @@ bool SVGElement::setAttribute(const Attribute& attribute)
 
 void SVGElement::parseAttribute(PropertyID id, const std::string& value)
 {
+    if(id == PropertyID::Class) {
+        std::vector<std::string> classNames;
+        std::string_view input(value);
+        while(skipOptionalSpaces(input)) {
+            std::string_view name(input);
+            while(!input.empty() && !IS_WS(input.front()))
+                input.remove_prefix(1);
+            name.remove_suffix(input.length());
+            if(std::find(classNames.begin(), classNames.end(), name) == classNames.end()) {
+                classNames.emplace_back(name);
+            }
+        }
+
+        // Elements cloned by <use> have no document index and stay out of the class index.
+        if(m_documentIndex > 0)
+            rootElement()->updateClassIndex(this, m_classNames, classNames);
+        m_classNames = std::move(classNames);
+    } else if(id == PropertyID::Id) {
+        if(m_documentIndex > 0) {
+            rootElement()->updateElementId(this, getAttribute(PropertyID::Id), value);
+        }
+    } else if(id == PropertyID::Href) {
+        if(auto reference = uriReference()) {
+            reference->invalidateTargetElement();
+        }
+    }
+
     if(auto property = getProperty(id)) {
         property->parse(value);
     }
 }
 
-SVGElement* SVGElement::previousElement() const
+bool SVGElement::hasClassName(const std::string_view& name) const
 {
-    if(!parent())
-        return nullptr;
-    const auto& children = parent()->children();
-    auto it = children.begin();
-    auto end = children.end();
-    SVGElement* element = nullptr;
-    for(; it != end; ++it) {
-        SVGNode* node = &**it;
-        if(node->isTextNode())
-            continue;
-        if(node == this)
-            return element;
-        element = static_cast<SVGElement*>(node);
-    }
-
-    return nullptr;
+    return std::find(m_classNames.begin(), m_classNames.end(), name) != m_classNames.end();
 }
 
-SVGElement* SVGElement::nextElement() const
+SVGNode* SVGElement::addChild(std::unique_ptr<SVGNode> child)
 {
-    if(!parent())
-        return nullptr;
-    const auto& children = parent()->children();
-    auto it = children.rbegin();
-    auto end = children.rend();
-    SVGElement* element = nullptr;
-    for(; it != end; ++it) {
-        SVGNode* node = &**it;
-        if(node->isTextNode())
-            continue;
-        if(node == this)
-            return element;
-        element = static_cast<SVGElement*>(node);
+    child->setParent(this);
+    if(auto previousChild = lastChild()) {
+        previousChild->m_nextSibling = child.get();
+        child->m_previousSibling = previousChild;
     }
 
-    return nullptr;
-}
+    if(auto element = toSVGElement(child.get())) {
+        auto previousChild = child->m_previousSibling;
+        while(previousChild && !previousChild->isElement())
+            previousChild = previousChild->m_previousSibling;
+        if(auto previousElement = toSVGElement(previousChild)) {
+            previousElement->m_nextElement = element;
+            element->m_previousElement = previousElement;
+        }
+    }
 
-SVGNode* SVGElement::addChild(std::unique_ptr<SVGNode> child)
-{
-    child->setParent(this);
     m_children.push_back(std::move(child));
     return &*m_children.back();
 }
@@ -446,12 +625,26 @@ void SVGElement::layout(SVGLayoutState& state)
     layoutChildren(newState);
 }
 
+static bool isOutsideCanvas(const Rect& deviceBoundingBox, const SVGRenderState& state)
+{
+    auto boundingBox = deviceBoundingBox;
+    boundingBox.inflate(1.f);
+    return boundingBox.intersected(state->extents()).isEmpty();
+}
+
 void SVGElement::renderChildren(SVGRenderState& state) const
 {
     for(const auto& child : m_children) {
-        if(auto element = toSVGElement(child)) {
-            element->render(state);
-        }
+        auto element = toSVGElement(child);
+        if(element == nullptr || element->isHiddenElement())
+            continue;
+        if(state.isAborted())
+            break;
+        auto boundingBox = (state.currentTransform() * element->localTransform()).mapRect(element->paintBoundingBox());
+        if(isOutsideCanvas(boundingBox, state))
+            continue;
+        SVGTraceScope scope("render", element, boundingBox);
+        element->render(state);
     }
 }
 
@@ -516,10 +709,22 @@ SVGURIReference::SVGURIReference(SVGElement* element)
 
 SVGElement* SVGURIReference::getTargetElement(const Document* document) const
 {
+    auto rootElement = document->rootElement();
+    if(m_targetGeneration > 0 && m_targetGeneration == rootElement->referenceGeneration())
+        return m_targetElement;
     std::string_view value(m_href.value());
     if(value.empty() || value.front() != '#')
         return nullptr;
-    return document->rootElement()->getElementById(value.substr(1));
+    return rootElement->getElementById(value.substr(1));
+}
+
+void SVGURIReference::resolveTargetElement(const SVGRootElement* rootElement)
+{
+    m_targetElement = nullptr;
+    std::string_view value(m_href.value());
+    if(!value.empty() && value.front() == '#')
+        m_targetElement = rootElement->getElementById(value.substr(1));
+    m_targetGeneration = rootElement->referenceGeneration();
 }
 
 bool SVGPaintServer::applyPaint(SVGRenderState& state) const
@@ -606,33 +811,341 @@ void SVGSVGElement::render(SVGRenderState& state) const
         return;
     SVGBlendInfo blendInfo(this);
     SVGRenderState newState(this, state, localTransform());
-    newState.beginGroup(blendInfo);
+    if(!newState.beginGroup(blendInfo))
+        return;
     if(isOverflowHidden())
         newState->clipRect(getClipRect(viewportSize), FillRule::NonZero, newState.currentTransform());
     renderChildren(newState);
     newState.endGroup(blendInfo);
 }
 
+static std::atomic<uint64_t> documentVersion(0);
+
 SVGRootElement::SVGRootElement(Document* document)
     : SVGSVGElement(document)
+    , m_version(++documentVersion)
+{
+}
+
+void SVGRootElement::updateVersion()
+{
+    // Versions are unique across documents, so a render cache key never matches another document.
+    m_version = ++documentVersion;
+}
+
+SVGElement* SVGElementIdTable::find(const std::string_view& id) const
+{
+    if(m_count == 0)
+        return nullptr;
+    if(auto slot = findSlot(id, xxhash64(id.data(), id.length())))
+        return slot->element;
+    return nullptr;
+}
+
+bool SVGElementIdTable::isUnique(const std::string_view& id) const
+{
+    if(m_count == 0)
+        return false;
+    auto slot = findSlot(id, xxhash64(id.data(), id.length()));
+    return slot && slot->unique;
+}
+
+bool SVGElementIdTable::insert(const std::string_view& id, SVGElement* element)
+{
+    auto hash = xxhash64(id.data(), id.length());
+    if(m_count > 0) {
+        if(auto slot = findSlot(id, hash)) {
+            // The first element keeps the id, but lookups can no longer stand in for a tree walk.
+            if(slot->element != element)
+                slot->unique = false;
+            return false;
+        }
+    }
+
+    // Keeps the load factor at or below 3/4 so probe sequences stay short.
+    if(4 * (m_count + 1) > 3 * m_slots.size())
+        rehash(std::max<size_t>(16, 2 * m_slots.size()));
+    auto mask = m_slots.size() - 1;
+    auto index = hash & mask;
+    while(m_slots[index].element)
+        index = (index + 1) & mask;
+    auto& slot = m_slots[index];
+    slot.hash = hash;
+    slot.offset = static_cast<uint32_t>(m_keys.length());
+    slot.length = static_cast<uint32_t>(id.length());
+    slot.element = element;
+    m_keys.append(id);
+    m_keyBytes += id.length();
+    m_count += 1;
+    return true;
+}
+
+bool SVGElementIdTable::erase(const std::string_view& id)
+{
+    if(m_count == 0)
+        return false;
+    auto slot = findSlot(id, xxhash64(id.data(), id.length()));
+    if(slot == nullptr)
+        return false;
+    m_keyBytes -= slot->length;
+    m_count -= 1;
+
+    // Backward-shift deletion: pull later entries of the probe run into the hole so lookups never need tombstones.
+    auto mask = m_slots.size() - 1;
+    auto hole = static_cast<size_t>(slot - m_slots.data());
+    for(auto index = (hole + 1) & mask; m_slots[index].element; index = (index + 1) & mask) {
+        auto home = m_slots[index].hash & mask;
+        if(((index - home) & mask) >= ((index - hole) & mask)) {
+            m_slots[hole] = m_slots[index];
+            hole = index;
+        }
+    }
+
+    m_slots[hole] = Slot();
+    if(m_keys.length() > 2 * m_keyBytes + 256)
+        compactKeys();
+    return true;
+}
+
+size_t SVGElementIdTable::heapSize() const
+{
+    return lunasvg::heapSize(m_slots) + lunasvg::heapSize(m_keys);
+}
+
+const SVGElementIdTable::Slot* SVGElementIdTable::findSlot(const std::string_view& id, uint64_t hash) const
 {
+    auto mask = m_slots.size() - 1;
+    for(auto index = hash & mask; m_slots[index].element; index = (index + 1) & mask) {
+        const auto& slot = m_slots[index];
+        if(slot.hash == hash && slot.length == id.length() && id.compare(0, id.length(), m_keys.data() + slot.offset, slot.length) == 0) {
+            return &slot;
+        }
+    }
+
+    return nullptr;
+}
+
+void SVGElementIdTable::rehash(size_t capacity)
+{
+    std::vector<Slot> slots(capacity);
+    auto mask = capacity - 1;
+    for(const auto& slot : m_slots) {
+        if(slot.element == nullptr)
+            continue;
+        auto index = slot.hash & mask;
+        while(slots[index].element)
+            index = (index + 1) & mask;
+        slots[index] = slot;
+    }
+
+    m_slots.swap(slots);
+}
+
+void SVGElementIdTable::compactKeys()
+{
+    std::string keys;
+    keys.reserve(m_keyBytes);
+    for(auto& slot : m_slots) {
+        if(slot.element == nullptr)
+            continue;
+        auto offset = static_cast<uint32_t>(keys.length());
+        keys.append(m_keys, slot.offset, slot.length);
+        slot.offset = offset;
+    }
+
+    m_keys.swap(keys);
 }
 
 SVGElement* SVGRootElement::getElementById(const std::string_view& id) const
 {
-    auto it = m_idCache.find(id);
-    if(it == m_idCache.end())
+    return m_idCache.find(id);
+}
+
+bool SVGRootElement::isUniqueId(const std::string_view& id) const
+{
+    return m_idCache.isUnique(id);
+}
+
+void SVGRootElement::updateElementId(SVGElement* element, const std::string& oldId, const std::string& newId)
+{
+    // While parsing, elements arrive in document order, so the first one registered keeps the id.
+    if(m_referenceGeneration == 0) {
+        if(!newId.empty())
+            m_idCache.insert(newId, element);
+        return;
+    }
+
+    // Afterwards, both ids are rebuilt from a tree walk so each still belongs to its first element in document order.
+    m_idCache.erase(oldId);
+    m_idCache.erase(newId);
+    transverse([&](SVGNode* node) {
+        auto child = toSVGElement(node);
+        if(child == nullptr || child->documentIndex() == 0)
+            return true;
+        const auto& id = child == element ? newId : child->getAttribute(PropertyID::Id);
+        if(!id.empty() && (id == oldId || id == newId))
+            m_idCache.insert(id, child);
+        return true;
+    });
+
+    // Stored href targets were resolved against the old ids, so getTargetElement falls back to table lookups.
+    m_referenceGeneration += 1;
+}
+
+void SVGRootElement::resolveReferences()
+{
+    m_referenceGeneration += 1;
+    transverse([this](SVGNode* node) {
+        if(auto element = toSVGElement(node)) {
+            if(auto reference = element->uriReference()) {
+                reference->resolveTargetElement(this);
+            }
+        }
+
+        return true;
+    });
+}
+
+const std::vector<SVGElement*>* SVGRootElement::getElementsByClassName(const std::string_view& name) const
+{
+    auto it = m_classIndex.find(name);
+    if(it == m_classIndex.end())
         return nullptr;
-    return it->second;
+    return &it->second;
+}
+
+static bool isBeforeInDocument(const SVGElement* a, const SVGElement* b)
+{
+    return a->documentIndex() < b->documentIndex();
+}
+
+void SVGRootElement::updateClassIndex(SVGElement* element, const std::vector<std::string>& oldNames, const std::vector<std::string>& newNames)
+{
+    for(const auto& name : oldNames) {
+        if(std::find(newNames.begin(), newNames.end(), name) != newNames.end())
+            continue;
+        auto it = m_classIndex.find(name);
+        if(it == m_classIndex.end())
+            continue;
+        auto& elements = it->second;
+        auto position = std::lower_bound(elements.begin(), elements.end(), element, isBeforeInDocument);
+        if(position != elements.end() && *position == element)
+            elements.erase(position);
+        if(elements.empty()) {
+            m_classIndex.erase(it);
+        }
+    }
+
+    for(const auto& name : newNames) {
+        if(std::find(oldNames.begin(), oldNames.end(), name) != oldNames.end())
+            continue;
+        auto& elements = m_classIndex[name];
+        if(elements.empty() || isBeforeInDocument(elements.back(), element)) {
+            elements.push_back(element);
+        } else {
+            elements.insert(std::lower_bound(elements.begin(), elements.end(), element, isBeforeInDocument), element);
+        }
+    }
+}
+
+size_t SVGRootElement::classIndexHeapSize() const
+{
+    // Each tree node holds the colour, parent and child links ahead of the entry.
+    constexpr size_t kNodeHeaderSize = 4 * sizeof(void*);
+    size_t size = 0;
+    for(const auto& [name, elements] : m_classIndex)
+        size += kNodeHeaderSize + sizeof(decltype(m_classIndex)::value_type) + heapSize(name) + heapSize(elements);
+    return size;
+}
+
+size_t SVGRootElement::idCacheHeapSize() const
+{
+    return m_idCache.heapSize();
+}
+
+bool SVGRootElement::expandUse(size_t elementCount)
+{
+    m_useExpansion += elementCount;
+    if(m_resourceLimits.maxUseExpansion > 0 && m_useExpansion > m_resourceLimits.maxUseExpansion)
+        m_useExpansionExceeded = true;
+    return !m_useExpansionExceeded;
 }
 
-void SVGRootElement::addElementById(const std::string& id, SVGElement* element)
+void SVGRootElement::setTracingEnabled(bool enabled)
 {
-    m_idCache.emplace(id, element);
+    if(!enabled) {
+        m_tracer.reset();
+    } else if(m_tracer == nullptr) {
+        m_tracer = std::make_unique<SVGTracer>();
+    }
+}
+
+void SVGRootElement::clearTrace()
+{
+    if(m_tracer) {
+        m_tracer = std::make_unique<SVGTracer>();
+    }
+}
+
+void SVGRootElement::setStatisticsEnabled(bool enabled)
+{
+    if(!enabled) {
+        m_statistics.reset();
+    } else if(m_statistics == nullptr) {
+        m_statistics = std::make_unique<SVGStatistics>();
+    }
+}
+
+static bool isAxisAligned(const Transform& transform)
+{
+    return transform.matrix().b == 0.f && transform.matrix().c == 0.f;
+}
+
+bool SVGRootElement::hasOpaqueBackground(const Transform& transform, const Rect& deviceRect) const
+{
+    if(isDisplayNone() || clipper() || masker() || opacity() < 1.f)
+        return false;
+    LengthContext lengthContext(this);
+    const Size viewportSize = {
+        lengthContext.valueForLength(width()),
+        lengthContext.valueForLength(height())
+    };
+
+    if(viewportSize.isEmpty())
+        return false;
+    const SVGElement* firstElement = nullptr;
+    for(const auto& child : children()) {
+        if(auto element = toSVGElement(child); element && !element->isHiddenElement()) {
+            firstElement = element;
+            break;
+        }
+    }
+
+    if(firstElement == nullptr || firstElement->id() != ElementID::Rect)
+        return false;
+    auto rectElement = static_cast<const SVGRectElement*>(firstElement);
+    if(rectElement->isVisibilityHidden() || rectElement->clipper() || rectElement->masker() || rectElement->opacity() < 1.f)
+        return false;
+    const auto& fill = rectElement->fill();
+    if(fill.element() || fill.opacity() < 1.f || !fill.color().isOpaque() || rectElement->hasRoundedCorners())
+        return false;
+    auto rootTransform = transform * localTransform();
+    auto rectTransform = rootTransform * rectElement->localTransform();
+    if(!isAxisAligned(rootTransform) || !isAxisAligned(rectTransform))
+        return false;
+    auto coverage = rectTransform.mapRect(rectElement->fillBoundingBox());
+    if(isOverflowHidden())
+        coverage.intersect(rootTransform.mapRect(getClipRect(viewportSize)));
+    // Any partially covered edge pixel would blend over whatever the bitmap held before, so the
+    // fill must reach every edge of the pixel-aligned device rect with no tolerance.
+    return coverage.x <= deviceRect.x && coverage.y <= deviceRect.y
+        && coverage.right() >= deviceRect.right() && coverage.bottom() >= deviceRect.bottom();
 }
 
 void SVGRootElement::layout(SVGLayoutState& state)
 {
+    // Layout reloads image files and picks up the font faces registered since the last one.
+    updateVersion();
     SVGSVGElement::layout(state);
 
     LengthContext lengthContext(this);
@@ -704,7 +1217,8 @@ void SVGUseElement::render(SVGRenderState& state) const
         return;
     SVGBlendInfo blendInfo(this);
     SVGRenderState newState(this, state, localTransform());
-    newState.beginGroup(blendInfo);
+    if(!newState.beginGroup(blendInfo))
+        return;
     renderChildren(newState);
     newState.endGroup(blendInfo);
 }
@@ -713,6 +1227,15 @@ void SVGUseElement::build()
 {
     if(auto targetElement = getTargetElement(document())) {
         if(auto newElement = cloneTargetElement(targetElement)) {
+            size_t elementCount = 0;
+            newElement->transverse([&elementCount](const SVGNode* node) {
+                if(!node->isTextNode())
+                    ++elementCount;
+                return true;
+            });
+
+            if(!rootElement()->expandUse(elementCount))
+                return;
             addChild(std::move(newElement));
         }
     }
@@ -822,7 +1345,8 @@ void SVGImageElement::render(SVGRenderState& state) const
 
     SVGBlendInfo blendInfo(this);
     SVGRenderState newState(this, state, localTransform());
-    newState.beginGroup(blendInfo);
+    if(!newState.beginGroup(blendInfo))
+        return;
     newState->drawImage(m_image, dstRect, srcRect, newState.currentTransform());
     newState.endGroup(blendInfo);
 }
@@ -844,6 +1368,8 @@ static Bitmap loadImageResource(const std::string& href)
 void SVGImageElement::layoutElement(const SVGLayoutState& state)
 {
     m_image = loadImageResource(hrefString());
+    if(auto statistics = this->statistics())
+        SVGStatistics::add(statistics->imageDecodes);
     SVGGraphicsElement::layoutElement(state);
 }
 
@@ -864,7 +1390,8 @@ void SVGGElement::render(SVGRenderState& state) const
         return;
     SVGBlendInfo blendInfo(this);
     SVGRenderState newState(this, state, localTransform());
-    newState.beginGroup(blendInfo);
+    if(!newState.beginGroup(blendInfo))
+        return;
     renderChildren(newState);
     newState.endGroup(blendInfo);
 }
@@ -942,7 +1469,8 @@ void SVGMarkerElement::renderMarker(SVGRenderState& state, const Point& origin,
         return;
     SVGBlendInfo blendInfo(this);
     SVGRenderState newState(this, state, markerTransform(origin, angle, strokeWidth));
-    newState.beginGroup(blendInfo);
+    if(!newState.beginGroup(blendInfo))
+        return;
     if(isOverflowHidden())
         newState->clipRect(getClipRect(markerSize()), FillRule::NonZero, newState.currentTransform());
     renderChildren(newState);
@@ -979,7 +1507,15 @@ void SVGClipPathElement::applyClipMask(SVGRenderState& state) const
 {
     if(state.hasCycleReference(this))
         return;
-    auto maskImage = Canvas::create(state.currentTransform().mapRect(state.paintBoundingBox()));
+    auto maskExtents = state.currentTransform().mapRect(state.paintBoundingBox());
+    SVGLayerScope layer(state.context(), maskExtents);
+    if(!layer.isAllocated())
+        return;
+    auto maskImage = Canvas::create(maskExtents);
+    maskImage->setQuality(state->quality());
+    if(auto statistics = this->statistics())
+        SVGStatistics::add(statistics->clipMaskRenders);
+    SVGTraceScope scope("clipMask", this, maskImage->extents());
     auto currentTransform = state.currentTransform() * localTransform();
     if(m_clipPathUnits.value() == Units::ObjectBoundingBox) {
         auto bbox = state.fillBoundingBox();
@@ -1120,8 +1656,16 @@ void SVGMaskElement::applyMask(SVGRenderState& state) const
 {
     if(state.hasCycleReference(this))
         return;
-    auto maskImage = Canvas::create(state.currentTransform().mapRect(state.paintBoundingBox()));
+    auto maskExtents = state.currentTransform().mapRect(state.paintBoundingBox());
+    SVGLayerScope layer(state.context(), maskExtents);
+    if(!layer.isAllocated())
+        return;
+    auto maskImage = Canvas::create(maskExtents);
+    maskImage->setQuality(state->quality());
     maskImage->clipRect(maskRect(state.element()), FillRule::NonZero, state.currentTransform());
+    if(auto statistics = this->statistics())
+        SVGStatistics::add(statistics->maskRenders);
+    SVGTraceScope scope("mask", this, maskImage->extents());
 
     auto currentTransform = state.currentTransform();
     if(m_maskContentUnits.value() == Units::ObjectBoundingBox) {
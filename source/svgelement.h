@@ -2,9 +2,15 @@
 #define LUNASVG_SVGELEMENT_H
 
 #include <string>
+#include <atomic>
+#include <chrono>
 #include <forward_list>
 #include <list>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "svgproperty.h"
 #include "lunasvg.h"
@@ -15,6 +21,76 @@ class Document;
 class SVGElement;
 class SVGRootElement;
 
+class SVGStatistics {
+public:
+    std::atomic<uint64_t> layoutTime{0};
+    std::atomic<uint64_t> renderTime{0};
+    std::atomic<uint64_t> layersAllocated{0};
+    std::atomic<uint64_t> layerPixels{0};
+    std::atomic<uint64_t> maskRenders{0};
+    std::atomic<uint64_t> clipMaskRenders{0};
+    std::atomic<uint64_t> gradientResolutions{0};
+    std::atomic<uint64_t> patternResolutions{0};
+    std::atomic<uint64_t> imageDecodes{0};
+    std::atomic<uint64_t> glyphsDrawn{0};
+
+    static void add(std::atomic<uint64_t>& counter, uint64_t value = 1) { counter.fetch_add(value, std::memory_order_relaxed); }
+};
+
+class SVGStatisticsTimer {
+public:
+    SVGStatisticsTimer(SVGStatistics* statistics, std::atomic<uint64_t> SVGStatistics::*counter)
+        : m_statistics(statistics), m_counter(counter)
+    {
+        if(m_statistics) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~SVGStatisticsTimer()
+    {
+        if(m_statistics == nullptr)
+            return;
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        SVGStatistics::add(m_statistics->*m_counter, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+private:
+    SVGStatistics* m_statistics;
+    std::atomic<uint64_t> SVGStatistics::*m_counter;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+class SVGTracer {
+public:
+    struct Event {
+        const char* name;
+        const char* tag;
+        std::string id;
+        Rect boundingBox;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    struct ThreadBuffer {
+        std::thread::id threadId;
+        std::mutex mutex;
+        std::vector<Event> events;
+    };
+
+    SVGTracer();
+
+    ThreadBuffer* threadBuffer();
+    uint64_t now() const;
+    std::string exportJson() const;
+
+private:
+    const uint64_t m_serial;
+    const std::chrono::steady_clock::time_point m_epoch;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+};
+
 class SVGNode {
 public:
     SVGNode(Document* document)
@@ -30,9 +106,13 @@ public:
     virtual bool isTextPositioningElement() const { return false; }
 
     SVGRootElement* rootElement() const;
+    SVGStatistics* statistics() const;
+    SVGTracer* tracer() const;
     Document* document() const { return m_document; }
     void setParent(SVGElement* parent) { m_parent = parent; }
     SVGElement* parent() const { return m_parent; }
+    SVGNode* previousSibling() const { return m_previousSibling; }
+    SVGNode* nextSibling() const { return m_nextSibling; }
 
     virtual std::unique_ptr<SVGNode> clone(bool deep) const = 0;
 
@@ -41,6 +121,9 @@ private:
     SVGNode& operator=(const SVGNode&) = delete;
     Document* m_document;
     SVGElement* m_parent = nullptr;
+    SVGNode* m_previousSibling = nullptr;
+    SVGNode* m_nextSibling = nullptr;
+    friend class SVGElement;
 };
 
 class SVGTextNode final : public SVGNode {
@@ -49,7 +132,7 @@ public:
 
     bool isTextNode() const final { return true; }
 
-    void setData(const std::string& data) { m_data = data; }
+    void setData(const std::string& data);
     const std::string& data() const { return m_data; }
 
     std::unique_ptr<SVGNode> clone(bool deep) const final;
@@ -106,6 +189,7 @@ enum class ElementID : uint8_t {
 };
 
 ElementID elementid(const std::string_view& name);
+const char* elementname(ElementID id);
 
 using SVGNodeList = std::list<std::unique_ptr<SVGNode>>;
 using SVGPropertyList = std::forward_list<SVGProperty*>;
@@ -117,6 +201,8 @@ class SVGPaintElement;
 class SVGLayoutState;
 class SVGRenderState;
 
+class SVGURIReference;
+
 class SVGElement : public SVGNode {
 public:
     static std::unique_ptr<SVGElement> create(Document* document, ElementID id);
@@ -136,9 +222,16 @@ public:
     bool setAttribute(const Attribute& attribute);
 
     virtual void parseAttribute(PropertyID id, const std::string& value);
+    virtual SVGURIReference* uriReference() { return nullptr; }
 
-    SVGElement* previousElement() const;
-    SVGElement* nextElement() const;
+    const std::vector<std::string>& classNames() const { return m_classNames; }
+    bool hasClassName(const std::string_view& name) const;
+
+    uint32_t documentIndex() const { return m_documentIndex; }
+    void setDocumentIndex(uint32_t documentIndex) { m_documentIndex = documentIndex; }
+
+    SVGElement* previousElement() const { return m_previousElement; }
+    SVGElement* nextElement() const { return m_nextElement; }
     SVGNode* addChild(std::unique_ptr<SVGNode> child);
     SVGNode* firstChild() const;
     SVGNode* lastChild() const;
@@ -152,6 +245,7 @@ public:
     virtual Rect fillBoundingBox() const;
     virtual Rect strokeBoundingBox() const;
     virtual Rect paintBoundingBox() const;
+    void invalidatePaintBoundingBox() { m_paintBoundingBox = Rect::Invalid; }
 
     SVGMarkerElement* getMarker(const std::string_view& id) const;
     SVGClipPathElement* getClipper(const std::string_view& id) const;
@@ -200,6 +294,10 @@ private:
     AttributeList m_attributes;
     SVGPropertyList m_properties;
     SVGNodeList m_children;
+    SVGElement* m_previousElement = nullptr;
+    SVGElement* m_nextElement = nullptr;
+    std::vector<std::string> m_classNames;
+    uint32_t m_documentIndex = 0;
 
     mutable Rect m_paintBoundingBox = Rect::Invalid;
     const SVGClipPathElement* m_clipper = nullptr;
@@ -267,8 +365,13 @@ public:
     const std::string& hrefString() const { return m_href.value(); }
     SVGElement* getTargetElement(const Document* document) const;
 
+    void resolveTargetElement(const SVGRootElement* rootElement);
+    void invalidateTargetElement() { m_targetGeneration = 0; }
+
 private:
     SVGString m_href;
+    SVGElement* m_targetElement = nullptr;
+    uint32_t m_targetGeneration = 0; ///< The root's reference generation at resolve time, or zero when unresolved.
 };
 
 class SVGPaintServer {
@@ -327,6 +430,37 @@ private:
     SVGLength m_height;
 };
 
+class SVGElementIdTable {
+public:
+    SVGElementIdTable() = default;
+
+    SVGElement* find(const std::string_view& id) const;
+    bool isUnique(const std::string_view& id) const;
+    bool insert(const std::string_view& id, SVGElement* element);
+    bool erase(const std::string_view& id);
+    size_t size() const { return m_count; }
+    size_t heapSize() const;
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        SVGElement* element = nullptr;
+        bool unique = true; ///< Cleared once a second element claims the same id.
+    };
+
+    const Slot* findSlot(const std::string_view& id, uint64_t hash) const;
+    Slot* findSlot(const std::string_view& id, uint64_t hash) { return const_cast<Slot*>(std::as_const(*this).findSlot(id, hash)); }
+    void rehash(size_t capacity);
+    void compactKeys();
+
+    std::vector<Slot> m_slots;
+    std::string m_keys;
+    size_t m_keyBytes = 0; ///< Bytes of m_keys still used by a slot.
+    size_t m_count = 0;
+};
+
 class SVGRootElement final : public SVGSVGElement {
 public:
     SVGRootElement(Document* document);
@@ -335,11 +469,46 @@ public:
     float intrinsicHeight() const { return m_intrinsicHeight; }
 
     SVGElement* getElementById(const std::string_view& id) const;
-    void addElementById(const std::string& id, SVGElement* element);
+    bool isUniqueId(const std::string_view& id) const;
+    void updateElementId(SVGElement* element, const std::string& oldId, const std::string& newId);
+    size_t idCacheHeapSize() const;
+    void resolveReferences();
+    uint32_t referenceGeneration() const { return m_referenceGeneration; }
+
+    const std::vector<SVGElement*>* getElementsByClassName(const std::string_view& name) const;
+    void updateClassIndex(SVGElement* element, const std::vector<std::string>& oldNames, const std::vector<std::string>& newNames);
+    size_t classIndexHeapSize() const;
+
     void layout(SVGLayoutState& state) final;
 
+    bool hasOpaqueBackground(const Transform& transform, const Rect& deviceRect) const;
+
+    SVGStatistics* statistics() const { return m_statistics.get(); }
+    void setStatisticsEnabled(bool enabled);
+
+    SVGTracer* tracer() const { return m_tracer.get(); }
+    void setTracingEnabled(bool enabled);
+    void clearTrace();
+
+    const ResourceLimits& resourceLimits() const { return m_resourceLimits; }
+    void setResourceLimits(const ResourceLimits& limits) { m_resourceLimits = limits; }
+
+    bool expandUse(size_t elementCount);
+    bool isUseExpansionExceeded() const { return m_useExpansionExceeded; }
+
+    uint64_t version() const { return m_version; }
+    void updateVersion();
+
 private:
-    std::map<std::string, SVGElement*, std::less<>> m_idCache;
+    SVGElementIdTable m_idCache;
+    std::map<std::string, std::vector<SVGElement*>, std::less<>> m_classIndex;
+    std::unique_ptr<SVGStatistics> m_statistics;
+    std::unique_ptr<SVGTracer> m_tracer;
+    ResourceLimits m_resourceLimits;
+    size_t m_useExpansion{0};
+    bool m_useExpansionExceeded{false};
+    uint64_t m_version;
+    uint32_t m_referenceGeneration{0}; ///< Zero until resolveReferences, then bumped on every id change.
     float m_intrinsicWidth{0};
     float m_intrinsicHeight{0};
 };
@@ -357,6 +526,8 @@ public:
     void render(SVGRenderState& state) const final;
     void build() final;
 
+    SVGURIReference* uriReference() final { return this; }
+
 private:
     std::unique_ptr<SVGElement> cloneTargetElement(SVGElement* targetElement);
     SVGLength m_x;
@@ -381,6 +552,8 @@ public:
     void render(SVGRenderState& state) const final;
     void layoutElement(const SVGLayoutState& state) final;
 
+    SVGURIReference* uriReference() final { return this; }
+
 private:
     SVGLength m_x;
     SVGLength m_y;
@@ -140,9 +140,12 @@ void SVGGeometryElement::render(SVGRenderState& state) const
 {
     if(m_path.isNull() || isVisibilityHidden() || isDisplayNone())
         return;
+    if(auto context = state.context(); context && !context->drawPath(m_path))
+        return;
     SVGBlendInfo blendInfo(this);
     SVGRenderState newState(this, state, localTransform());
-    newState.beginGroup(blendInfo);
+    if(!newState.beginGroup(blendInfo))
+        return;
     if(newState.mode() == SVGRenderMode::Clipping) {
         newState->setColor(Color::White);
         newState->fillPath(m_path, m_clip_rule, newState.currentTransform());
@@ -204,6 +207,12 @@ SVGRectElement::SVGRectElement(Document* document)
     addProperty(m_ry);
 }
 
+bool SVGRectElement::hasRoundedCorners() const
+{
+    LengthContext lengthContext(this);
+    return lengthContext.valueForLength(m_rx) > 0.f || lengthContext.valueForLength(m_ry) > 0.f;
+}
+
 Rect SVGRectElement::updateShape(Path& path)
 {
     LengthContext lengthContext(this);
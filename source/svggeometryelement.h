@@ -39,11 +39,16 @@ public:
     FillRule fill_rule() const { return m_fill_rule; }
     FillRule clip_rule() const { return m_clip_rule; }
 
+    const SVGPaintServer& fill() const { return m_fill; }
+    const SVGPaintServer& stroke() const { return m_stroke; }
+
     virtual Rect updateShape(Path& path) = 0;
     void updateMarkerPositions(SVGMarkerPositionList& positions, const SVGLayoutState& state);
     void render(SVGRenderState& state) const override;
 
     const Path& path() const { return m_path; }
+    const StrokeData& strokeData() const { return m_strokeData; }
+    const SVGMarkerPositionList& markerPositions() const { return m_markerPositions; }
 
 private:
     Path m_path;
@@ -75,6 +80,7 @@ class SVGRectElement final : public SVGGeometryElement {
 public:
     SVGRectElement(Document* document);
 
+    bool hasRoundedCorners() const;
     Rect updateShape(Path& path) final;
 
 private:
@@ -127,6 +127,8 @@ static GradientStops buildGradientStops(const SVGGradientElement* element, float
 
 bool SVGLinearGradientElement::applyPaint(SVGRenderState& state, float opacity) const
 {
+    if(auto statistics = this->statistics())
+        SVGStatistics::add(statistics->gradientResolutions);
     auto attributes = collectGradientAttributes();
     auto gradientContentElement = attributes.gradientContentElement();
     auto gradientStops = buildGradientStops(gradientContentElement, opacity);
@@ -172,6 +174,8 @@ SVGRadialGradientElement::SVGRadialGradientElement(Document* document)
 
 bool SVGRadialGradientElement::applyPaint(SVGRenderState& state, float opacity) const
 {
+    if(auto statistics = this->statistics())
+        SVGStatistics::add(statistics->gradientResolutions);
     auto attributes = collectGradientAttributes();
     auto gradientContentElement = attributes.gradientContentElement();
     auto gradientStops = buildGradientStops(gradientContentElement, opacity);
@@ -286,7 +290,14 @@ bool SVGPatternElement::applyPaint(SVGRenderState& state, float opacity) const
     auto xScale = currentTransform.xScale();
     auto yScale = currentTransform.yScale();
 
-    auto patternImage = Canvas::create(0, 0, patternRect.w * xScale, patternRect.h * yScale);
+    Rect patternExtents(0, 0, patternRect.w * xScale, patternRect.h * yScale);
+    SVGLayerScope layer(state.context(), patternExtents);
+    if(!layer.isAllocated())
+        return false;
+    auto patternImage = Canvas::create(patternExtents);
+    patternImage->setQuality(state->quality());
+    if(auto statistics = this->statistics())
+        SVGStatistics::add(statistics->patternResolutions);
     auto patternImageTransform = Transform::scaled(xScale, yScale);
 
     const auto& viewBoxRect = attributes.viewBox();
@@ -298,6 +309,7 @@ bool SVGPatternElement::applyPaint(SVGRenderState& state, float opacity) const
         patternImageTransform.scale(bbox.w, bbox.h);
     }
 
+    SVGTraceScope scope("pattern", this, patternImage->extents());
     SVGRenderState newState(this, &state, patternImageTransform, SVGRenderMode::Painting, patternImage);
     patternContentElement->renderChildren(newState);
     auto patternTransform = attributes.patternTransform();
@@ -307,6 +319,11 @@ bool SVGPatternElement::applyPaint(SVGRenderState& state, float opacity) const
     return true;
 }
 
+const SVGPatternElement* SVGPatternElement::patternContentElement() const
+{
+    return collectPatternAttributes().patternContentElement();
+}
+
 SVGPatternAttributes SVGPatternElement::collectPatternAttributes() const
 {
     SVGPatternAttributes attributes;
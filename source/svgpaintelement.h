@@ -39,6 +39,8 @@ public:
     const SVGEnumeration<SpreadMethod>& spreadMethod() const { return m_spreadMethod; }
     void collectGradientAttributes(SVGGradientAttributes& attributes) const;
 
+    SVGURIReference* uriReference() final { return this; }
+
 private:
     SVGTransform m_gradientTransform;
     SVGEnumeration<Units> m_gradientUnits;
@@ -208,6 +210,9 @@ public:
     const SVGEnumeration<Units>& patternContentUnits() const { return m_patternContentUnits; }
 
     bool applyPaint(SVGRenderState& state, float opacity) const final;
+    const SVGPatternElement* patternContentElement() const;
+
+    SVGURIReference* uriReference() final { return this; }
 
 private:
     SVGPatternAttributes collectPatternAttributes() const;
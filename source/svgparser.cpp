@@ -2,6 +2,10 @@
 #include "svgelement.h"
 #include "svgparserutils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
 namespace lunasvg {
 
 struct SimpleSelector;
@@ -88,6 +92,7 @@ public:
 
 private:
     static bool matchSimpleSelector(const SimpleSelector& selector, const SVGElement* element);
+    static bool matchCompoundSelector(const Selector& selector, const SVGElement* element);
     static bool matchAttributeSelector(const AttributeSelector& selector, const SVGElement* element);
     static bool matchPseudoClassSelector(const PseudoClassSelector& selector, const SVGElement* element);
 
@@ -153,6 +158,17 @@ bool RuleData::matchSimpleSelector(const SimpleSelector& selector, const SVGElem
     return true;
 }
 
+bool RuleData::matchCompoundSelector(const Selector& selector, const SVGElement* element)
+{
+    for(const auto& simpleSelector : selector) {
+        if(!matchSimpleSelector(simpleSelector, element)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 constexpr bool equals(const std::string_view& value, const std::string_view& subvalue)
 {
     return value.compare(subvalue) == 0;
@@ -204,6 +220,8 @@ constexpr bool dashequals(const std::string_view& value, const std::string_view&
 
 bool RuleData::matchAttributeSelector(const AttributeSelector& selector, const SVGElement* element)
 {
+    if(selector.id == PropertyID::Class && selector.matchType == AttributeSelector::MatchType::Includes)
+        return element->hasClassName(selector.value);
     const auto& value = element->getAttribute(selector.id);
     if(selector.matchType == AttributeSelector::MatchType::None)
         return !value.empty();
@@ -222,6 +240,28 @@ bool RuleData::matchAttributeSelector(const AttributeSelector& selector, const S
     return false;
 }
 
+static bool isFirstOfType(const SVGElement* element)
+{
+    for(auto sibling = element->previousElement(); sibling; sibling = sibling->previousElement()) {
+        if(sibling->id() == element->id()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool isLastOfType(const SVGElement* element)
+{
+    for(auto sibling = element->nextElement(); sibling; sibling = sibling->nextElement()) {
+        if(sibling->id() == element->id()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool RuleData::matchPseudoClassSelector(const PseudoClassSelector& selector, const SVGElement* element)
 {
     if(selector.type == PseudoClassSelector::Type::Empty)
@@ -230,22 +270,18 @@ bool RuleData::matchPseudoClassSelector(const PseudoClassSelector& selector, con
         return element->parent() == nullptr;
     if(selector.type == PseudoClassSelector::Type::Is) {
         for(const auto& subSelector : selector.subSelectors) {
-            for(const auto& simpleSelector : subSelector) {
-                if(!matchSimpleSelector(simpleSelector, element)) {
-                    return false;
-                }
+            if(matchCompoundSelector(subSelector, element)) {
+                return true;
             }
         }
 
-        return true;
+        return false;
     }
 
     if(selector.type == PseudoClassSelector::Type::Not) {
         for(const auto& subSelector : selector.subSelectors) {
-            for(const auto& simpleSelector : subSelector) {
-                if(matchSimpleSelector(simpleSelector, element)) {
-                    return false;
-                }
+            if(matchCompoundSelector(subSelector, element)) {
+                return false;
             }
         }
 
@@ -258,44 +294,37 @@ bool RuleData::matchPseudoClassSelector(const PseudoClassSelector& selector, con
         return !element->nextElement();
     if(selector.type == PseudoClassSelector::Type::OnlyChild)
         return !(element->previousElement() || element->nextElement());
-    if(selector.type == PseudoClassSelector::Type::FirstOfType) {
-        auto sibling = element->previousElement();
-        while(sibling) {
-            if(sibling->id() == element->id())
-                return false;
-            sibling = element->previousElement();
-        }
-
-        return true;
-    }
-
-    if(selector.type == PseudoClassSelector::Type::LastOfType) {
-        auto sibling = element->nextElement();
-        while(sibling) {
-            if(sibling->id() == element->id())
-                return false;
-            sibling = element->nextElement();
-        }
-
-        return true;
-    }
-
+    if(selector.type == PseudoClassSelector::Type::FirstOfType)
+        return isFirstOfType(element);
+    if(selector.type == PseudoClassSelector::Type::LastOfType)
+        return isLastOfType(element);
+    if(selector.type == PseudoClassSelector::Type::OnlyOfType)
+        return isFirstOfType(element) && isLastOfType(element);
     return false;
 }
 
 using RuleDataList = std::vector<RuleData>;
+using RuleDataRefList = std::vector<const RuleData*>;
 
 class StyleSheet {
 public:
     StyleSheet() = default;
 
     bool parseSheet(std::string_view input);
+    bool parseQuery(std::string_view input);
     const RuleDataList& rules() const { return m_rules; }
     bool isEmpty() const { return m_rules.empty(); }
 
     void sortRules();
 
+    void collectRules(const SVGElement* element, RuleDataRefList& rules) const;
+    bool matchAny(const SVGElement* element, RuleDataRefList& rules) const;
+    std::string_view singleIdKey() const;
+    std::string_view singleClassKey() const;
+
 private:
+    void buildIndex();
+
     static bool parseRule(std::string_view& input, Rule& rule);
     static bool parseSelectors(std::string_view& input, SelectorList& selectors);
     static bool parseDeclarations(std::string_view& input, DeclarationList& declarations);
@@ -304,6 +333,13 @@ private:
 
     RuleDataList m_rules;
     size_t m_position{0};
+
+    // Rules bucketed by the id, class or tag of their rightmost compound selector. The keys
+    // view strings owned by m_rules, so the index is rebuilt whenever the rules move.
+    std::unordered_map<std::string_view, RuleDataRefList> m_idRules;
+    std::unordered_map<std::string_view, RuleDataRefList> m_classRules;
+    std::map<ElementID, RuleDataRefList> m_tagRules;
+    RuleDataRefList m_universalRules;
 };
 
 bool StyleSheet::parseSheet(std::string_view input)
@@ -349,9 +385,121 @@ bool StyleSheet::parseSheet(std::string_view input)
     return true;
 }
 
+bool StyleSheet::parseQuery(std::string_view input)
+{
+    SelectorList selectors;
+    skipOptionalSpaces(input);
+    if(!parseSelectors(input, selectors) || skipOptionalSpaces(input))
+        return false;
+    for(auto& selector : selectors) {
+        if(selector.empty())
+            return false;
+        m_rules.emplace_back(selector, DeclarationList(), 0, m_position++);
+    }
+
+    buildIndex();
+    return true;
+}
+
 void StyleSheet::sortRules()
 {
     std::sort(m_rules.begin(), m_rules.end());
+    buildIndex();
+}
+
+void StyleSheet::buildIndex()
+{
+    m_idRules.clear();
+    m_classRules.clear();
+    m_tagRules.clear();
+    m_universalRules.clear();
+    for(const auto& rule : m_rules) {
+        const auto& selector = rule.selector().back();
+        const AttributeSelector* idSelector = nullptr;
+        const AttributeSelector* classSelector = nullptr;
+        for(const auto& attributeSelector : selector.attributeSelectors) {
+            if(attributeSelector.id == PropertyID::Id && attributeSelector.matchType == AttributeSelector::MatchType::Equals) {
+                idSelector = &attributeSelector;
+                break;
+            }
+
+            if(classSelector == nullptr && attributeSelector.id == PropertyID::Class && attributeSelector.matchType == AttributeSelector::MatchType::Includes) {
+                classSelector = &attributeSelector;
+            }
+        }
+
+        if(idSelector) {
+            m_idRules[idSelector->value].push_back(&rule);
+        } else if(classSelector) {
+            m_classRules[classSelector->value].push_back(&rule);
+        } else if(selector.id != ElementID::Star) {
+            m_tagRules[selector.id].push_back(&rule);
+        } else {
+            m_universalRules.push_back(&rule);
+        }
+    }
+}
+
+void StyleSheet::collectRules(const SVGElement* element, RuleDataRefList& rules) const
+{
+    rules.clear();
+    auto addRules = [&rules](const RuleDataRefList& bucket) {
+        rules.insert(rules.end(), bucket.begin(), bucket.end());
+    };
+
+    if(!m_idRules.empty()) {
+        const auto& id = element->getAttribute(PropertyID::Id);
+        if(!id.empty()) {
+            auto it = m_idRules.find(id);
+            if(it != m_idRules.end()) {
+                addRules(it->second);
+            }
+        }
+    }
+
+    if(!m_classRules.empty()) {
+        for(const auto& name : element->classNames()) {
+            auto it = m_classRules.find(name);
+            if(it != m_classRules.end()) {
+                addRules(it->second);
+            }
+        }
+    }
+
+    auto it = m_tagRules.find(element->id());
+    if(it != m_tagRules.end())
+        addRules(it->second);
+    addRules(m_universalRules);
+
+    // Buckets hold pointers into m_rules, so pointer order is rule order.
+    std::sort(rules.begin(), rules.end());
+    rules.erase(std::unique(rules.begin(), rules.end()), rules.end());
+}
+
+bool StyleSheet::matchAny(const SVGElement* element, RuleDataRefList& rules) const
+{
+    collectRules(element, rules);
+    for(auto rule : rules) {
+        if(rule->match(element)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string_view StyleSheet::singleIdKey() const
+{
+    if(m_idRules.size() == 1 && m_classRules.empty() && m_tagRules.empty() && m_universalRules.empty())
+        return m_idRules.begin()->first;
+    return std::string_view();
+}
+
+std::string_view StyleSheet::singleClassKey() const
+{
+    if(m_classRules.size() == 1 && m_idRules.empty() && m_tagRules.empty() && m_universalRules.empty())
+        return m_classRules.begin()->first;
+    return std::string_view();
 }
 
 bool StyleSheet::parseRule(std::string_view& input, Rule& rule)
@@ -429,11 +577,12 @@ bool StyleSheet::parseDeclarations(std::string_view& input, DeclarationList& dec
 bool StyleSheet::parseSelector(std::string_view& input, Selector& selector)
 {
     do {
+        auto length = input.length();
         SimpleSelector simpleSelector;
-        if(!parseSimpleSelector(input, simpleSelector))
+        if(!parseSimpleSelector(input, simpleSelector) || input.length() == length)
             return false;
         selector.push_back(std::move(simpleSelector));
-    } while(skipOptionalSpaces(input) && input.front() != ',' && input.front() != '{');
+    } while(skipOptionalSpaces(input) && input.front() != ',' && input.front() != '{' && input.front() != ')');
     return true;
 }
 
@@ -454,6 +603,8 @@ bool StyleSheet::parseSimpleSelector(std::string_view& input, SimpleSelector& si
                 selector.type = PseudoClassSelector::Type::Empty;
             else if(name.compare("root") == 0)
                 selector.type = PseudoClassSelector::Type::Root;
+            else if(name.compare("is") == 0)
+                selector.type = PseudoClassSelector::Type::Is;
             else if(name.compare("not") == 0)
                 selector.type = PseudoClassSelector::Type::Not;
             else if(name.compare("first-child") == 0)
@@ -563,15 +714,16 @@ bool StyleSheet::parseSimpleSelector(std::string_view& input, SimpleSelector& si
     return true;
 }
 
-inline void parseInlineStyle(std::string_view input, SVGElement* element)
+inline int parseInlineStyle(std::string_view input, SVGElement* element)
 {
+    int count = 0;
     std::string name;
     std::string value;
     skipOptionalSpaces(input);
     while(readCSSIdentifier(input, name)) {
         skipOptionalSpaces(input);
         if(!skipDelimiter(input, ':'))
-            return;
+            return count;
         value.clear();
         while(!input.empty() && input.front() != ';') {
             value.push_back(input.front());
@@ -579,10 +731,15 @@ inline void parseInlineStyle(std::string_view input, SVGElement* element)
         }
 
         auto id = csspropertyid(name);
-        if(id != PropertyID::Unknown)
+        if(id != PropertyID::Unknown) {
             element->setAttribute(0x100, id, value);
+            ++count;
+        }
+
         skipOptionalSpacesOrDelimiter(input, ';');
     }
+
+    return count;
 }
 
 inline void removeStyleComments(std::string& value)
@@ -680,8 +837,17 @@ inline bool readIdentifier(std::string_view& input, std::string& output)
     return true;
 }
 
-bool Document::parse(const char* data, size_t length)
+static double elapsedMilliseconds(std::chrono::steady_clock::time_point start)
 {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+bool Document::parse(const char* data, size_t length, const ResourceLimits& limits)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t elementCount = 0;
+    uint32_t documentIndex = 0;
     std::string buffer;
     std::string styleSheet;
     SVGElement* currentElement = nullptr;
@@ -807,16 +973,23 @@ bool Document::parse(const char* data, size_t length)
             } else {
                 if(m_rootElement && currentElement == nullptr)
                     return false;
+                if(limits.maxElements > 0 && ++elementCount > limits.maxElements)
+                    return false;
                 if(m_rootElement == nullptr) {
                     if(id != ElementID::Svg)
                         return false;
                     m_rootElement = std::make_unique<SVGRootElement>(this);
+                    m_rootElement->setResourceLimits(limits);
                     element = m_rootElement.get();
                 } else {
                     auto child = SVGElement::create(this, id);
                     element = child.get();
                     currentElement->addChild(std::move(child));
                 }
+
+                // Counted apart from the statistics, which resetStatistics may clear at any time.
+                element->setDocumentIndex(++documentIndex);
+                m_loadStatistics.elementsCreated++;
             }
         }
 
@@ -840,11 +1013,10 @@ bool Document::parse(const char* data, size_t length)
                 decodeText(input.substr(0, n), buffer);
                 if(id == PropertyID::Style) {
                     removeStyleComments(buffer);
-                    parseInlineStyle(buffer, element);
+                    m_loadStatistics.attributesSet += parseInlineStyle(buffer, element);
                 } else {
-                    if(id == PropertyID::Id)
-                        m_rootElement->addElementById(buffer, element);
                     element->setAttribute(0x1, id, buffer);
+                    m_loadStatistics.attributesSet++;
                 }
             }
 
@@ -871,25 +1043,36 @@ bool Document::parse(const char* data, size_t length)
 
     if(m_rootElement == nullptr || ignoring > 0 || !input.empty())
         return false;
+    m_loadStatistics.tokenizeTime += elapsedMilliseconds(start);
     applyStyleSheet(styleSheet);
+    start = std::chrono::steady_clock::now();
     m_rootElement->build();
-    return true;
+    m_rootElement->resolveReferences();
+    m_loadStatistics.buildTime += elapsedMilliseconds(start);
+    return !m_rootElement->isUseExpansionExceeded();
 }
 
 void Document::applyStyleSheet(const std::string& content)
 {
+    auto start = std::chrono::steady_clock::now();
     StyleSheet styleSheet;
     styleSheet.parseSheet(content);
     if(!styleSheet.isEmpty()) {
         styleSheet.sortRules();
-        m_rootElement->transverse([&styleSheet](SVGNode* node) {
+        auto& statistics = m_loadStatistics;
+        RuleDataRefList rules;
+        m_rootElement->transverse([&styleSheet, &statistics, &rules](SVGNode* node) {
             if(node->isTextNode())
                 return true;
             auto element = static_cast<SVGElement*>(node);
-            for(const auto& rule : styleSheet.rules()) {
-                if(rule.match(element)) {
-                    for(const auto& declaration : rule.declarations()) {
+            styleSheet.collectRules(element, rules);
+            for(auto rule : rules) {
+                statistics.rulesTested++;
+                if(rule->match(element)) {
+                    statistics.rulesMatched++;
+                    for(const auto& declaration : rule->declarations()) {
                         element->setAttribute(declaration.specificity, declaration.id, declaration.value);
+                        statistics.attributesSet++;
                     }
                 }
             }
@@ -897,6 +1080,134 @@ void Document::applyStyleSheet(const std::string& content)
             return true;
         });
     }
+
+    m_loadStatistics.cascadeTime += elapsedMilliseconds(start);
+}
+
+static bool isInclusiveDescendant(const SVGElement* element, const SVGElement* scope)
+{
+    for(; element; element = element->parent()) {
+        if(element == scope) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<typename Callback>
+static bool queryDescendants(const StyleSheet& query, SVGElement* element, RuleDataRefList& rules, Callback& callback)
+{
+    for(const auto& child : element->children()) {
+        if(auto childElement = toSVGElement(child)) {
+            if(query.matchAny(childElement, rules) && !callback(childElement))
+                return false;
+            if(childElement->id() != ElementID::Use && !queryDescendants(query, childElement, rules, callback)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template<typename Callback>
+static void querySelectors(const std::string& content, SVGElement* scope, bool includeScope, Callback callback)
+{
+    StyleSheet query;
+    if(!query.parseQuery(content))
+        return;
+    RuleDataRefList rules;
+    auto id = query.singleIdKey();
+    if(!id.empty() && scope->rootElement()->isUniqueId(id)) {
+        auto element = scope->rootElement()->getElementById(id);
+        if(element && (includeScope || element != scope) && isInclusiveDescendant(element, scope) && query.matchAny(element, rules))
+            callback(element);
+        return;
+    }
+
+    auto name = query.singleClassKey();
+    if(!name.empty() && scope->documentIndex() > 0) {
+        auto elements = scope->rootElement()->getElementsByClassName(name);
+        if(elements == nullptr)
+            return;
+        auto isRootScope = scope == scope->rootElement();
+        for(auto element : *elements) {
+            if(element == scope && !includeScope)
+                continue;
+            if((isRootScope || isInclusiveDescendant(element, scope)) && query.matchAny(element, rules) && !callback(element)) {
+                return;
+            }
+        }
+
+        return;
+    }
+
+    if(includeScope && query.matchAny(scope, rules) && !callback(scope))
+        return;
+    queryDescendants(query, scope, rules, callback);
+}
+
+Element Element::querySelector(const std::string& selector) const
+{
+    Element result;
+    if(m_node) {
+        querySelectors(selector, element(), false, [&result](SVGElement* element) {
+            result = Element(element);
+            return false;
+        });
+    }
+
+    return result;
+}
+
+ElementList Element::querySelectorAll(const std::string& selector) const
+{
+    ElementList elements;
+    querySelectorAll(selector, elements);
+    return elements;
+}
+
+size_t Element::querySelectorAll(const std::string& selector, ElementList& elements) const
+{
+    auto count = elements.size();
+    if(m_node) {
+        querySelectors(selector, element(), false, [&elements](SVGElement* element) {
+            elements.push_back(Element(element));
+            return true;
+        });
+    }
+
+    return elements.size() - count;
+}
+
+Element Document::querySelector(const std::string& selector) const
+{
+    Element result;
+    querySelectors(selector, m_rootElement.get(), true, [&result](SVGElement* element) {
+        result = Element(element);
+        return false;
+    });
+
+    return result;
+}
+
+ElementList Document::querySelectorAll(const std::string& selector) const
+{
+    ElementList elements;
+    querySelectorAll(selector, elements);
+    return elements;
+}
+
+size_t Document::querySelectorAll(const std::string& selector, ElementList& elements) const
+{
+    auto count = elements.size();
+    querySelectors(selector, m_rootElement.get(), true, [&elements](SVGElement* element) {
+        elements.push_back(Element(element));
+        return true;
+    });
+
+    return elements.size() - count;
 }
 
 } // namespace lunasvg
@@ -99,6 +99,7 @@ public:
     PropertyID id() const { return m_id; }
 
     virtual bool parse(std::string_view input) = 0;
+    virtual size_t heapSize() const { return 0; }
 
 private:
     SVGProperty(const SVGProperty&) = delete;
@@ -114,6 +115,7 @@ public:
 
     const std::string& value() const { return m_value; }
     bool parse(std::string_view input) final;
+    size_t heapSize() const final { return lunasvg::heapSize(m_value); }
 
 private:
     std::string m_value;
@@ -321,6 +323,7 @@ public:
     LengthNegativeMode negativeMode() const { return m_negativeMode; }
     const LengthList& values() const { return m_values; }
     bool parse(std::string_view input) final;
+    size_t heapSize() const final { return lunasvg::heapSize(m_values); }
 
 private:
     const LengthDirection m_direction;
@@ -387,6 +390,7 @@ public:
 
     const NumberList& values() const { return m_values; }
     bool parse(std::string_view input) final;
+    size_t heapSize() const final { return lunasvg::heapSize(m_values); }
 
 private:
     NumberList m_values;
@@ -400,6 +404,7 @@ public:
 
     const Path& value() const { return m_value; }
     bool parse(std::string_view input) final;
+    size_t heapSize() const final { return m_value.heapSize(); }
 
 private:
     Path m_value;
@@ -428,6 +433,7 @@ public:
 
     const PointList& values() const { return m_values; }
     bool parse(std::string_view input) final;
+    size_t heapSize() const final { return lunasvg::heapSize(m_values); }
 
 private:
     PointList m_values;
@@ -1,5 +1,8 @@
 #include "svgrenderstate.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace lunasvg {
 
 SVGBlendInfo::SVGBlendInfo(const SVGElement* element)
@@ -14,6 +17,79 @@ bool SVGBlendInfo::requiresCompositing(SVGRenderMode mode) const
     return (m_clipper && m_clipper->requiresMasking()) || (mode == SVGRenderMode::Painting && (m_masker || m_opacity < 1.f));
 }
 
+SVGRenderContext::SVGRenderContext(const ResourceLimits& limits, const CancellationToken* cancellationToken, Clock::time_point deadline)
+    : m_limits(limits), m_cancellationToken(cancellationToken), m_deadline(deadline)
+{
+    if(m_limits.maxRenderTime > 0) {
+        m_deadline = std::min(m_deadline, deadlineAfter(m_limits.maxRenderTime));
+    }
+}
+
+SVGRenderContext::Clock::time_point SVGRenderContext::deadlineAfter(double milliseconds)
+{
+    if(milliseconds <= 0)
+        return Clock::time_point::max();
+    std::chrono::duration<double, std::milli> duration(milliseconds);
+    return Clock::now() + std::chrono::duration_cast<Clock::duration>(duration);
+}
+
+bool SVGRenderContext::checkAborted()
+{
+    if(m_status != RenderStatus::Completed)
+        return true;
+    if(m_cancellationToken && m_cancellationToken->isCancelled())
+        m_status = RenderStatus::Cancelled;
+    else if(m_deadline != Clock::time_point::max() && Clock::now() >= m_deadline)
+        m_status = RenderStatus::TimedOut;
+    return isAborted();
+}
+
+static uint64_t layerByteCount(const Rect& extents, int& width, int& height)
+{
+    // Matches the pixel-aligned extents chosen by Canvas::create.
+    width = static_cast<int>(std::ceil(extents.right())) - static_cast<int>(std::floor(extents.x));
+    height = static_cast<int>(std::ceil(extents.bottom())) - static_cast<int>(std::floor(extents.y));
+    if(extents.isEmpty() || width <= 0 || height <= 0)
+        return 0;
+    return uint64_t(width) * uint64_t(height) * 4;
+}
+
+bool SVGRenderContext::allocateLayer(const Rect& extents)
+{
+    if(isAborted())
+        return false;
+    int width, height;
+    auto byteCount = layerByteCount(extents, width, height);
+    if(m_limits.maxLayerSize > 0 && (width > m_limits.maxLayerSize || height > m_limits.maxLayerSize))
+        m_status = RenderStatus::LimitExceeded;
+    else if(m_limits.maxLayerBytes > 0 && m_layerBytes + byteCount > m_limits.maxLayerBytes)
+        m_status = RenderStatus::LimitExceeded;
+    else
+        m_layerBytes += byteCount;
+    return !isAborted();
+}
+
+void SVGRenderContext::releaseLayer(const Rect& extents)
+{
+    int width, height;
+    m_layerBytes -= std::min(m_layerBytes, layerByteCount(extents, width, height));
+}
+
+bool SVGRenderContext::drawPath(const Path& path)
+{
+    if(isAborted())
+        return false;
+    if(m_limits.maxPathSegments > 0) {
+        for(PathIterator it(path); !it.isDone(); it.next())
+            ++m_pathSegments;
+        if(m_pathSegments > m_limits.maxPathSegments) {
+            m_status = RenderStatus::LimitExceeded;
+        }
+    }
+
+    return !isAborted();
+}
+
 bool SVGRenderState::hasCycleReference(const SVGElement* element) const
 {
     auto current = this;
@@ -25,13 +101,25 @@ bool SVGRenderState::hasCycleReference(const SVGElement* element) const
     return false;
 }
 
-void SVGRenderState::beginGroup(const SVGBlendInfo& blendInfo)
+bool SVGRenderState::beginGroup(const SVGBlendInfo& blendInfo)
 {
     auto requiresCompositing = blendInfo.requiresCompositing(m_mode);
     if(requiresCompositing) {
         auto boundingBox = m_currentTransform.mapRect(m_element->paintBoundingBox());
         boundingBox.intersect(m_canvas->extents());
+        if(m_context && !m_context->allocateLayer(boundingBox)) {
+            // Nothing was pushed, so the caller returns without drawing or calling endGroup.
+            return false;
+        }
+
+        SVGTraceScope scope("beginGroup", m_element, boundingBox);
+        auto quality = m_canvas->quality();
         m_canvas = Canvas::create(boundingBox);
+        m_canvas->setQuality(quality);
+        if(auto statistics = m_element->statistics()) {
+            SVGStatistics::add(statistics->layersAllocated);
+            SVGStatistics::add(statistics->layerPixels, uint64_t(m_canvas->width()) * m_canvas->height());
+        }
     } else {
         m_canvas->save();
     }
@@ -39,6 +127,8 @@ void SVGRenderState::beginGroup(const SVGBlendInfo& blendInfo)
     if(!requiresCompositing && blendInfo.clipper()) {
         blendInfo.clipper()->applyClipPath(*this);
     }
+
+    return true;
 }
 
 void SVGRenderState::endGroup(const SVGBlendInfo& blendInfo)
@@ -48,14 +138,23 @@ void SVGRenderState::endGroup(const SVGBlendInfo& blendInfo)
         return;
     }
 
-    auto opacity = m_mode == SVGRenderMode::Clipping ? 1.f : blendInfo.opacity();
-    if(blendInfo.clipper())
-        blendInfo.clipper()->applyClipMask(*this);
-    if(m_mode == SVGRenderMode::Painting && blendInfo.masker()) {
-        blendInfo.masker()->applyMask(*this);
+    // The layer stays counted until it is composited, so the clip and mask canvases allocated
+    // below are measured against the limit on top of it.
+    if(m_context == nullptr || !m_context->isAborted()) {
+        SVGTraceScope scope("endGroup", m_element, m_canvas->extents());
+        auto opacity = m_mode == SVGRenderMode::Clipping ? 1.f : blendInfo.opacity();
+        if(blendInfo.clipper())
+            blendInfo.clipper()->applyClipMask(*this);
+        if(m_mode == SVGRenderMode::Painting && blendInfo.masker())
+            blendInfo.masker()->applyMask(*this);
+        if(m_context == nullptr || !m_context->isAborted()) {
+            m_parent->m_canvas->blendCanvas(*m_canvas, BlendMode::Src_Over, opacity);
+        }
     }
 
-    m_parent->m_canvas->blendCanvas(*m_canvas, BlendMode::Src_Over, opacity);
+    if(m_context) {
+        m_context->releaseLayer(m_canvas->extents());
+    }
 }
 
 } // namespace lunasvg
@@ -28,15 +28,97 @@ private:
     const float m_opacity;
 };
 
+class SVGRenderContext {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SVGRenderContext(const ResourceLimits& limits, const CancellationToken* cancellationToken, Clock::time_point deadline = Clock::time_point::max());
+
+    static Clock::time_point deadlineAfter(double milliseconds);
+
+    RenderStatus status() const { return m_status; }
+    bool isAborted() const { return m_status != RenderStatus::Completed; }
+    bool checkAborted();
+
+    bool allocateLayer(const Rect& extents);
+    void releaseLayer(const Rect& extents);
+    bool drawPath(const Path& path);
+
+private:
+    const ResourceLimits& m_limits;
+    const CancellationToken* m_cancellationToken;
+    Clock::time_point m_deadline;
+    uint64_t m_layerBytes{0};
+    uint64_t m_pathSegments{0};
+    RenderStatus m_status{RenderStatus::Completed};
+};
+
+class SVGLayerScope {
+public:
+    SVGLayerScope(SVGRenderContext* context, const Rect& extents)
+        : m_context(context), m_extents(extents)
+        , m_allocated(context == nullptr || context->allocateLayer(extents))
+    {}
+
+    ~SVGLayerScope()
+    {
+        if(m_context && m_allocated) {
+            m_context->releaseLayer(m_extents);
+        }
+    }
+
+    bool isAllocated() const { return m_allocated; }
+
+private:
+    SVGLayerScope(const SVGLayerScope&) = delete;
+    SVGLayerScope& operator=(const SVGLayerScope&) = delete;
+    SVGRenderContext* m_context;
+    const Rect m_extents;
+    const bool m_allocated;
+};
+
+class SVGTraceScope {
+public:
+    SVGTraceScope(const char* name, const SVGElement* element, const Rect& boundingBox)
+        : m_tracer(element->tracer())
+    {
+        if(m_tracer == nullptr)
+            return;
+        SVGTracer::Event event = {name, elementname(element->id()), element->getAttribute(PropertyID::Id), boundingBox, m_tracer->now(), 0};
+        m_buffer = m_tracer->threadBuffer();
+        std::lock_guard<std::mutex> lock(m_buffer->mutex);
+        m_index = m_buffer->events.size();
+        m_buffer->events.push_back(std::move(event));
+    }
+
+    ~SVGTraceScope()
+    {
+        if(m_buffer == nullptr)
+            return;
+        auto end = m_tracer->now();
+        std::lock_guard<std::mutex> lock(m_buffer->mutex);
+        auto& event = m_buffer->events[m_index];
+        event.duration = end - event.start;
+    }
+
+private:
+    SVGTraceScope(const SVGTraceScope&) = delete;
+    SVGTraceScope& operator=(const SVGTraceScope&) = delete;
+    SVGTracer* m_tracer;
+    SVGTracer::ThreadBuffer* m_buffer{nullptr};
+    size_t m_index{0};
+};
+
 class SVGRenderState {
 public:
     SVGRenderState(const SVGElement* element, const SVGRenderState& parent, const Transform& localTransform)
         : m_element(element), m_parent(&parent), m_currentTransform(parent.currentTransform() * localTransform)
-        , m_mode(parent.mode()), m_canvas(parent.canvas())
+        , m_mode(parent.mode()), m_canvas(parent.canvas()), m_context(parent.context())
     {}
 
-    SVGRenderState(const SVGElement* element, const SVGRenderState* parent, const Transform& currentTransform, SVGRenderMode mode, std::shared_ptr<Canvas> canvas)
+    SVGRenderState(const SVGElement* element, const SVGRenderState* parent, const Transform& currentTransform, SVGRenderMode mode, std::shared_ptr<Canvas> canvas, SVGRenderContext* context = nullptr)
         : m_element(element), m_parent(parent), m_currentTransform(currentTransform), m_mode(mode), m_canvas(std::move(canvas))
+        , m_context(parent ? parent->context() : context)
     {}
 
     Canvas& operator*() const { return *m_canvas; }
@@ -47,13 +129,16 @@ public:
     const Transform& currentTransform() const { return m_currentTransform; }
     const SVGRenderMode mode() const { return m_mode; }
     const std::shared_ptr<Canvas>& canvas() const { return m_canvas; }
+    SVGRenderContext* context() const { return m_context; }
+
+    bool isAborted() const { return m_context && m_context->checkAborted(); }
 
     Rect fillBoundingBox() const { return m_element->fillBoundingBox(); }
     Rect paintBoundingBox() const { return m_element->paintBoundingBox(); }
 
     bool hasCycleReference(const SVGElement* element) const;
 
-    void beginGroup(const SVGBlendInfo& blendInfo);
+    bool beginGroup(const SVGBlendInfo& blendInfo);
     void endGroup(const SVGBlendInfo& blendInfo);
 
 private:
@@ -62,6 +147,7 @@ private:
     const Transform m_currentTransform;
     const SVGRenderMode m_mode;
     std::shared_ptr<Canvas> m_canvas;
+    SVGRenderContext* m_context;
 };
 
 } // namespace lunasvg
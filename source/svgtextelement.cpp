@@ -333,11 +333,13 @@ void SVGTextElement::render(SVGRenderState& state) const
         return;
     SVGBlendInfo blendInfo(this);
     SVGRenderState newState(this, state, localTransform());
-    newState.beginGroup(blendInfo);
+    if(!newState.beginGroup(blendInfo))
+        return;
     if(newState.mode() == SVGRenderMode::Clipping) {
         newState->setColor(Color::White);
     }
 
+    auto statistics = this->statistics();
     std::u32string_view wholeText(m_text);
     for(const auto& fragment : m_fragments) {
         auto transform = newState.currentTransform() * Transform::rotated(fragment.angle, fragment.x, fragment.y);
@@ -347,14 +349,25 @@ void SVGTextElement::render(SVGRenderState& state) const
         const auto& font = fragment.element->font();
         if(newState.mode() == SVGRenderMode::Clipping) {
             newState->fillText(text, font, origin, transform);
+            if(statistics) {
+                SVGStatistics::add(statistics->glyphsDrawn, text.length());
+            }
         } else {
             const auto& fill = fragment.element->fill();
             const auto& stroke = fragment.element->stroke();
             auto stroke_width = fragment.element->stroke_width();
-            if(fill.applyPaint(newState))
+            if(fill.applyPaint(newState)) {
                 newState->fillText(text, font, origin, transform);
+                if(statistics) {
+                    SVGStatistics::add(statistics->glyphsDrawn, text.length());
+                }
+            }
+
             if(stroke.applyPaint(newState)) {
                 newState->strokeText(text, stroke_width, font, origin, transform);
+                if(statistics) {
+                    SVGStatistics::add(statistics->glyphsDrawn, text.length());
+                }
             }
         }
     }
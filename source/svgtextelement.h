@@ -122,6 +122,9 @@ public:
     void layout(SVGLayoutState& state) final;
     void render(SVGRenderState& state) const final;
 
+    const SVGTextFragmentList& fragments() const { return m_fragments; }
+    const std::u32string& text() const { return m_text; }
+
 private:
     Rect boundingBox(bool includeStroke) const;
     SVGTextFragmentList m_fragments;
@@ -0,0 +1,1064 @@
+#include <lunasvg.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace lunasvg;
+
+static int failureCount = 0;
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failureCount; \
+        } \
+    } while(0)
+
+static uint32_t pixelAt(const Bitmap& bitmap, int x, int y)
+{
+    auto row = bitmap.data() + y * bitmap.stride();
+    return reinterpret_cast<const uint32_t*>(row)[x];
+}
+
+static void testFrameThroughRenderCache()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                           "<rect id='r' width='8' height='8' fill='#ff0000'/></svg>");
+    CHECK(document != nullptr);
+
+    RenderCache cache;
+    document->renderToBitmap(cache);
+    auto bitmap = document->renderToBitmap(cache);
+    CHECK(cache.stats().hits == 1);
+    CHECK(pixelAt(bitmap, 4, 4) == 0xffff0000);
+
+    FrameRenderer frames(*document);
+    frames.setAttribute(document->getElementById("r"), "fill", "#0000ff");
+    frames.renderFrame();
+    bitmap = document->renderToBitmap(cache);
+    CHECK(cache.stats().hits == 1);
+    CHECK(pixelAt(bitmap, 4, 4) == 0xff0000ff);
+
+    document->applyStyleSheet("rect { fill: #00ff00 !important }");
+    document->updateLayout();
+    bitmap = document->renderToBitmap(cache);
+    CHECK(cache.stats().hits == 1);
+    CHECK(pixelAt(bitmap, 4, 4) == 0xff00ff00);
+}
+
+static void testLayerLimits()
+{
+    // One 8x8 layer takes 256 bytes, and so does the mask canvas composited into it.
+    ResourceLimits limits;
+    limits.maxLayerBytes = 128;
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                           "<rect width='8' height='8' fill='#ff0000' opacity='0.5'/></svg>", limits);
+    CHECK(document != nullptr);
+
+    Bitmap bitmap(8, 8);
+    bitmap.clear(0);
+    CHECK(document->render(bitmap, Matrix(), RenderOptions()) == RenderStatus::LimitExceeded);
+    CHECK(pixelAt(bitmap, 4, 4) == 0);
+
+    limits.maxLayerBytes = 384;
+    document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                      "<mask id='m'><rect width='8' height='8' fill='#fff'/></mask>"
+                                      "<g opacity='0.5' mask='url(#m)'><rect width='8' height='8' fill='#ff0000'/></g></svg>", limits);
+    CHECK(document != nullptr);
+    bitmap.clear(0);
+    CHECK(document->render(bitmap, Matrix(), RenderOptions()) == RenderStatus::LimitExceeded);
+    CHECK(pixelAt(bitmap, 4, 4) == 0);
+
+    limits.maxLayerBytes = 512;
+    document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                      "<mask id='m'><rect width='8' height='8' fill='#fff'/></mask>"
+                                      "<g opacity='0.5' mask='url(#m)'><rect width='8' height='8' fill='#ff0000'/></g></svg>", limits);
+    CHECK(document != nullptr);
+    bitmap.clear(0);
+    CHECK(document->render(bitmap, Matrix(), RenderOptions()) == RenderStatus::Completed);
+}
+
+static void testDuplicateIdQueries()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg'>"
+                                           "<rect id='a' class='first'/><g id='scope'><rect id='a' class='second'/></g>"
+                                           "<circle id='b'/></svg>");
+    CHECK(document != nullptr);
+
+    auto elements = document->querySelectorAll("#a");
+    CHECK(elements.size() == 2);
+    if(elements.size() == 2) {
+        CHECK(elements[0].getAttribute("class") == "first");
+        CHECK(elements[1].getAttribute("class") == "second");
+    }
+
+    auto scope = document->getElementById("scope");
+    CHECK(scope.querySelector("#a").getAttribute("class") == "second");
+    CHECK(scope.querySelectorAll("#a").size() == 1);
+
+    // An id assigned after loading is seen by queries even when it collides with a parsed one.
+    auto circle = document->querySelector("circle");
+    circle.setAttribute("id", "a");
+    CHECK(document->querySelectorAll("#a").size() == 3);
+    CHECK(document->querySelectorAll("#b").size() == 0);
+}
+
+static void testPartialBackgroundClears()
+{
+    BitmapPool pool;
+    auto stale = pool.acquire(8, 8);
+    stale.clear(0xff0000ff);
+    pool.release(std::move(stale));
+
+    // The fill stops short of the last column, so the pooled bitmap must still be cleared.
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                           "<rect width='7.999' height='8' fill='#0000ff'/></svg>");
+    CHECK(document != nullptr);
+    auto bitmap = document->renderToBitmap(pool, 8, 8);
+    CHECK(!bitmap.isNull());
+    CHECK(pool.stats().clearedPixels == 64);
+    CHECK((pixelAt(bitmap, 7, 4) & 0x00ff0000) == 0);
+    pool.release(std::move(bitmap));
+
+    document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                      "<rect width='8' height='8' fill='#0000ff'/></svg>");
+    CHECK(document != nullptr);
+    bitmap = document->renderToBitmap(pool, 8, 8);
+    CHECK(pool.stats().clearedPixels == 64);
+    CHECK(pixelAt(bitmap, 7, 4) == 0xff0000ff);
+}
+
+static void countBytes(void* closure, void*, int size)
+{
+    *static_cast<size_t*>(closure) += size;
+}
+
+static void testPngThreadCount()
+{
+    // Large enough to split into several deflate blocks when more than one thread is allowed.
+    Bitmap bitmap(512, 512);
+    bitmap.clear(0xff0000ff);
+    size_t expected = 0;
+    CHECK(bitmap.writeToPng(countBytes, &expected, PngOptions()));
+
+    PngOptions options;
+    options.threadCount = -4;
+    size_t bytes = 0;
+    CHECK(bitmap.writeToPng(countBytes, &bytes, options));
+    CHECK(bytes == expected);
+}
+
+static void testBandedRenderTargets()
+{
+    // 512 pixels wide, so the 256K pixel scratch band covers 512 rows and the frame takes two bands.
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='512' height='1024'>"
+                                           "<rect y='300' width='512' height='400' fill='#ff0000'/>"
+                                           "<rect x='100' y='500' width='200' height='500' fill='#00ff00' fill-opacity='0.5'/></svg>");
+    CHECK(document != nullptr);
+    auto expected = document->renderToBitmap(512, 1024, 0x0000ff80);
+    CHECK(!expected.isNull());
+
+    const PixelFormat formats[] = { PixelFormat::RGBA8888, PixelFormat::BGRA8888, PixelFormat::RGB565, PixelFormat::A8 };
+    for(auto format : formats) {
+        auto bytesPerPixel = RenderTarget(nullptr, 1, 1, 4, format).bytesPerPixel();
+        auto stride = 512 * bytesPerPixel + 8;
+        std::vector<uint8_t> converted(size_t(stride) * 1024, 0xAB);
+        std::vector<uint8_t> rendered(size_t(stride) * 1024, 0xAB);
+        CHECK(expected.convertTo(RenderTarget(converted.data(), 512, 1024, stride, format)));
+        document->renderToTarget(RenderTarget(rendered.data(), 512, 1024, stride, format), Matrix(), 0x0000ff80);
+        CHECK(rendered == converted);
+    }
+}
+
+static void appendBytes(void* closure, void* data, int size)
+{
+    static_cast<std::string*>(closure)->append(static_cast<const char*>(data), size);
+}
+
+static std::string encodeBase64(const std::string& data)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string output;
+    for(size_t index = 0; index < data.size(); index += 3) {
+        uint32_t value = uint8_t(data[index]) << 16;
+        if(index + 1 < data.size())
+            value |= uint8_t(data[index + 1]) << 8;
+        if(index + 2 < data.size())
+            value |= uint8_t(data[index + 2]);
+        output += alphabet[(value >> 18) & 63];
+        output += alphabet[(value >> 12) & 63];
+        output += index + 1 < data.size() ? alphabet[(value >> 6) & 63] : '=';
+        output += index + 2 < data.size() ? alphabet[value & 63] : '=';
+    }
+
+    return output;
+}
+
+static Bitmap decodePng(const std::string& png, int width, int height)
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='" + std::to_string(width) + "' height='" + std::to_string(height) + "'>"
+                                           "<image width='" + std::to_string(width) + "' height='" + std::to_string(height) + "' preserveAspectRatio='none' "
+                                           "href='data:image/png;base64," + encodeBase64(png) + "'/></svg>");
+    if(document == nullptr)
+        return Bitmap();
+    return document->renderToBitmap(width, height);
+}
+
+static bool samePixels(const Bitmap& a, const Bitmap& b)
+{
+    if(a.isNull() || b.isNull() || a.width() != b.width() || a.height() != b.height())
+        return false;
+    for(int y = 0; y < a.height(); ++y) {
+        if(std::memcmp(a.data() + y * a.stride(), b.data() + y * b.stride(), a.width() * 4) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void testPngRoundTrip()
+{
+    // Opaque, transparent and half-covered pixels whose premultiplied values survive the round trip.
+    Bitmap many(256, 256);
+    Bitmap few(64, 48);
+    for(int y = 0; y < many.height(); ++y) {
+        auto row = reinterpret_cast<uint32_t*>(many.data() + y * many.stride());
+        for(int x = 0; x < many.width(); ++x) {
+            row[x] = (x + y) % 7 == 0 ? 0 : (x + y) % 7 == 1 ? 0x80800000 : 0xff000000 | x << 16 | y << 8 | ((x * y) & 0xFF);
+        }
+    }
+
+    for(int y = 0; y < few.height(); ++y) {
+        auto row = reinterpret_cast<uint32_t*>(few.data() + y * few.stride());
+        for(int x = 0; x < few.width(); ++x) {
+            row[x] = x % 5 == 0 ? 0x80008000 : 0xff000000 | (x * 4) << 16 | ((y / 16) * 40);
+        }
+    }
+
+    const PngFilter filters[] = { PngFilter::None, PngFilter::Sub, PngFilter::Up, PngFilter::Average, PngFilter::Paeth, PngFilter::Adaptive };
+    for(auto level : { 0, 1, 6, 9 }) {
+        for(auto filter : filters) {
+            for(auto threadCount : { 1, 4 }) {
+                PngOptions options;
+                options.compressionLevel = level;
+                options.filter = filter;
+                options.threadCount = threadCount;
+                std::string png;
+                CHECK(many.writeToPng(appendBytes, &png, options));
+                CHECK(samePixels(decodePng(png, many.width(), many.height()), many));
+
+                options.palette = true;
+                png.clear();
+                CHECK(few.writeToPng(appendBytes, &png, options));
+                CHECK(png.size() > 25 && png[25] == 3);
+                CHECK(samePixels(decodePng(png, few.width(), few.height()), few));
+            }
+        }
+    }
+}
+
+static std::string decodeQoi(const std::string& qoi, int& width, int& height)
+{
+    // Decodes a QOI stream into plain RGBA bytes, following the reference specification.
+    std::string pixels;
+    if(qoi.size() < 22 || qoi.compare(0, 4, "qoif") != 0)
+        return pixels;
+    auto byteAt = [&](size_t index) { return uint8_t(qoi[index]); };
+    width = byteAt(4) << 24 | byteAt(5) << 16 | byteAt(6) << 8 | byteAt(7);
+    height = byteAt(8) << 24 | byteAt(9) << 16 | byteAt(10) << 8 | byteAt(11);
+    uint8_t seen[64][4] = {};
+    uint8_t pixel[4] = {0, 0, 0, 255};
+    size_t position = 14;
+    auto end = qoi.size() - 8;
+    while(pixels.size() < size_t(width) * height * 4 && position < end) {
+        auto tag = byteAt(position++);
+        int count = 1;
+        if(tag == 0xFE) {
+            pixel[0] = byteAt(position++);
+            pixel[1] = byteAt(position++);
+            pixel[2] = byteAt(position++);
+        } else if(tag == 0xFF) {
+            for(auto& channel : pixel) {
+                channel = byteAt(position++);
+            }
+        } else if((tag & 0xC0) == 0x00) {
+            std::memcpy(pixel, seen[tag], 4);
+        } else if((tag & 0xC0) == 0x40) {
+            pixel[0] += ((tag >> 4) & 3) - 2;
+            pixel[1] += ((tag >> 2) & 3) - 2;
+            pixel[2] += (tag & 3) - 2;
+        } else if((tag & 0xC0) == 0x80) {
+            auto next = byteAt(position++);
+            int green = (tag & 0x3F) - 32;
+            pixel[0] += green - 8 + ((next >> 4) & 0x0F);
+            pixel[1] += green;
+            pixel[2] += green - 8 + (next & 0x0F);
+        } else {
+            count = (tag & 0x3F) + 1;
+        }
+
+        std::memcpy(seen[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+        while(count-- > 0) {
+            pixels.append(reinterpret_cast<const char*>(pixel), 4);
+        }
+    }
+
+    if(qoi.compare(qoi.size() - 8, 8, std::string("\0\0\0\0\0\0\0\1", 8)) != 0)
+        pixels.clear();
+    return pixels;
+}
+
+static void testImageEncoders()
+{
+    // Runs, repeats of earlier colors, small and large differences, and partial alpha.
+    Bitmap bitmap(80, 3);
+    for(int y = 0; y < bitmap.height(); ++y) {
+        auto row = reinterpret_cast<uint32_t*>(bitmap.data() + y * bitmap.stride());
+        for(int x = 0; x < bitmap.width(); ++x) {
+            if(x < 20) {
+                row[x] = 0xff204060;
+            } else if(x < 40) {
+                row[x] = 0xff000000 | (x * 2) << 16 | (x * 3) << 8 | x;
+            } else if(x < 60) {
+                row[x] = x % 2 ? 0xff204060 : 0xff000000 | (x * 7 + y * 50) << 8;
+            } else {
+                row[x] = 0x80000000 | (x - 60) << 16 | 0x40 << 8;
+            }
+        }
+    }
+
+    std::string rgba(bitmap.width() * bitmap.height() * 4, '\0');
+    CHECK(bitmap.convertTo(RenderTarget(reinterpret_cast<uint8_t*>(&rgba[0]), bitmap.width(), bitmap.height(), bitmap.width() * 4, PixelFormat::RGBA8888)));
+
+    std::string qoi;
+    CHECK(bitmap.writeToQoi(appendBytes, &qoi));
+    int width = 0;
+    int height = 0;
+    CHECK(decodeQoi(qoi, width, height) == rgba);
+    CHECK(width == bitmap.width() && height == bitmap.height());
+    CHECK(qoi.size() < rgba.size());
+
+    std::string pam;
+    CHECK(bitmap.writeToPam(appendBytes, &pam));
+    CHECK(pam == "P7\nWIDTH 80\nHEIGHT 3\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n" + rgba);
+
+    std::string ppm;
+    std::string rgb;
+    for(int y = 0; y < bitmap.height(); ++y) {
+        for(int x = 0; x < bitmap.width(); ++x) {
+            auto pixel = pixelAt(bitmap, x, y);
+            rgb += char(pixel >> 16);
+            rgb += char(pixel >> 8);
+            rgb += char(pixel);
+        }
+    }
+
+    CHECK(bitmap.writeToPpm(appendBytes, &ppm));
+    CHECK(ppm == "P6\n80 3\n255\n" + rgb);
+
+    std::string raw;
+    std::string bgra;
+    for(int y = 0; y < bitmap.height(); ++y) {
+        for(int x = 0; x < bitmap.width(); ++x) {
+            auto pixel = pixelAt(bitmap, x, y);
+            for(int shift = 0; shift < 32; shift += 8) {
+                bgra += char(pixel >> shift);
+            }
+        }
+    }
+
+    CHECK(bitmap.writeToRaw(appendBytes, &raw));
+    CHECK(raw == std::string("LRAW\x50\0\0\0\x03\0\0\0\0\0\0\0", 16) + bgra);
+    CHECK(!Bitmap().writeToQoi(appendBytes, &raw));
+}
+
+static void testBandedPngStream()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='40' height='50'>"
+                                           "<rect x='5' y='7' width='30' height='31' fill='#ff8000'/>"
+                                           "<rect x='10' y='20' width='10' height='25' fill='#0080ff' fill-opacity='0.5'/></svg>");
+    CHECK(document != nullptr);
+    auto expected = document->renderToBitmap(-1, -1, 0xffffffff);
+
+    Bitmap bitmap(40, 50);
+    std::string png;
+    PngStreamEncoder encoder(40, 50, appendBytes, &png);
+    int bandCount = 0;
+    CHECK(document->renderBands(-1, -1, 16, [&](const Bitmap& band, int y) {
+        ++bandCount;
+        for(int row = 0; row < band.height(); ++row)
+            std::memcpy(bitmap.data() + (y + row) * bitmap.stride(), band.data() + row * band.stride(), band.width() * 4);
+        return encoder.writeRows(band);
+    }, 0xffffffff));
+    CHECK(bandCount == 4);
+    CHECK(samePixels(bitmap, expected));
+    CHECK(!encoder.writeRows(Bitmap(39, 1)));
+    CHECK(encoder.finish());
+    CHECK(samePixels(decodePng(png, 40, 50), expected));
+
+    bandCount = 0;
+    CHECK(!document->renderBands(-1, -1, 16, [&](const Bitmap&, int) { return ++bandCount < 2; }));
+    CHECK(bandCount == 2);
+
+    PngStreamEncoder unfinished(40, 50, appendBytes, &png);
+    CHECK(unfinished.writeRows(Bitmap(40, 10)));
+    CHECK(!unfinished.writeRows(Bitmap(40, 41)));
+    CHECK(!unfinished.finish());
+}
+
+static void testBatchRender()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='16' height='8'>"
+                                           "<rect x='2' y='1' width='10' height='5' fill='#00ff00'/></svg>");
+    CHECK(document != nullptr);
+    std::vector<RenderSize> sizes = { RenderSize(16, 8), RenderSize(64, -1), RenderSize(-1, 24), RenderSize(0, 0), RenderSize(100, 7) };
+    for(auto threadCount : { 1, 3 }) {
+        auto bitmaps = document->renderBatch(sizes, 0x000000ff, threadCount);
+        CHECK(bitmaps.size() == sizes.size());
+        for(size_t index = 0; index < sizes.size() && index < bitmaps.size(); ++index) {
+            CHECK(samePixels(bitmaps[index], document->renderToBitmap(sizes[index].width, sizes[index].height, 0x000000ff)));
+        }
+    }
+
+    // Text forces the single-threaded fallback, which must still produce every target.
+    document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='16' height='8'>"
+                                      "<rect width='8' height='8' fill='#ff0000'/><text y='6'>x</text></svg>");
+    CHECK(document != nullptr);
+    auto bitmaps = document->renderBatch(sizes, 0, 4);
+    CHECK(bitmaps.size() == sizes.size());
+    for(size_t index = 0; index < sizes.size() && index < bitmaps.size(); ++index) {
+        CHECK(samePixels(bitmaps[index], document->renderToBitmap(sizes[index].width, sizes[index].height)));
+    }
+}
+
+static void testPooledElementRender()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='32' height='32'>"
+                                           "<g id='g' transform='translate(4 4)'><rect width='2' height='2' fill='#00ff00'/>"
+                                           "<rect x='6' y='6' width='2' height='2' fill='#0000ff'/></g>"
+                                           "<g id='h' transform='translate(20 20)'><rect width='1' height='1' fill='#000000'/>"
+                                           "<rect x='7' y='7' width='1' height='1' fill='#000000'/></g></svg>");
+    CHECK(document != nullptr);
+    auto first = document->getElementById("g");
+    auto second = document->getElementById("h");
+
+    // The second render only clears what the first one recorded as drawn, so that record
+    // must cover the first element's content where it lands in the bitmap.
+    BitmapPool pool(64 * 1024 * 1024, true);
+    for(int pass = 0; pass < 2; ++pass) {
+        auto bitmap = first.renderToBitmap(pool, 8, 8, 0xffffff80);
+        CHECK(samePixels(bitmap, first.renderToBitmap(8, 8, 0xffffff80)));
+        pool.release(std::move(bitmap));
+        bitmap = second.renderToBitmap(pool, 8, 8, 0xffffff80);
+        CHECK(samePixels(bitmap, second.renderToBitmap(8, 8, 0xffffff80)));
+        CHECK(pixelAt(bitmap, 6, 6) == pixelAt(bitmap, 3, 3));
+        pool.release(std::move(bitmap));
+    }
+}
+
+static void testAbortedOpaqueRender()
+{
+    // The rect covers the whole frame, so the background clear is skipped, but the segment limit
+    // stops the render before the rect is drawn.
+    ResourceLimits limits;
+    limits.maxPathSegments = 1;
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                           "<rect width='8' height='8' fill='#0000ff'/></svg>", limits);
+    CHECK(document != nullptr);
+
+    BitmapPool pool;
+    auto stale = pool.acquire(8, 8);
+    stale.clear(0xff0000ff);
+    pool.release(std::move(stale));
+    auto bitmap = document->renderToBitmap(pool, 8, 8, 0x00ff00ff);
+    CHECK(pool.stats().reuses == 1);
+    CHECK(pixelAt(bitmap, 4, 4) == 0xff00ff00);
+
+    bitmap = document->renderToBitmap(8, 8, 0x00ff00ff);
+    CHECK(pixelAt(bitmap, 4, 4) == 0xff00ff00);
+
+    std::vector<uint32_t> pixels(64, 0xffff0000);
+    document->renderToTarget(RenderTarget(reinterpret_cast<uint8_t*>(pixels.data()), 8, 8, 32), Matrix(), 0x00ff00ff);
+    CHECK(pixels[36] == 0xff00ff00);
+}
+
+static void testTiles()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='64' height='32'>"
+                                           "<rect x='5' y='3' width='40' height='20' fill='#ff0000'/>"
+                                           "<rect x='30' y='12' width='30' height='18' fill='#0000ff'/></svg>");
+    CHECK(document != nullptr);
+    CHECK(document->tiles(0).size() == 1);
+    CHECK(document->tiles(1).size() == 2);
+    CHECK(document->tiles(-1).empty() && document->tiles(31).empty());
+
+    auto full = document->renderToBitmap();
+    auto tiles = document->tiles(2);
+    CHECK(tiles.size() == 8);
+    for(size_t index = 0; index < tiles.size(); ++index) {
+        const auto& tile = tiles[index];
+        CHECK(tile.z == 2 && tile.x == int(index % 4) && tile.y == int(index / 4));
+        CHECK(tile.rect.x == tile.x * 16.f && tile.rect.y == tile.y * 16.f && tile.rect.w == 16.f && tile.rect.h == 16.f);
+
+        Bitmap bitmap(16, 16);
+        bitmap.clear(0);
+        CHECK(document->renderRegion(bitmap, tile.rect, RenderOptions()) == RenderStatus::Completed);
+        Bitmap crop(full.data() + int(tile.rect.y) * full.stride() + int(tile.rect.x) * 4, 16, 16, full.stride());
+        CHECK(samePixels(bitmap, crop));
+    }
+}
+
+static void testRenderQuality()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='16' height='16'>"
+                                           "<rect width='8' height='16' fill='#ff0000'/></svg>");
+    CHECK(document != nullptr);
+    Bitmap expected(16, 16);
+    expected.clear(0);
+    document->render(expected);
+
+    RenderOptions options;
+    for(auto quality : { RenderQuality::Normal, RenderQuality::High }) {
+        Bitmap bitmap(16, 16);
+        bitmap.clear(0);
+        options.quality = quality;
+        CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::Completed);
+        CHECK(samePixels(bitmap, expected));
+    }
+
+    // The fast preview is upsampled, so the pixel left of the edge blends in its transparent neighbour.
+    Bitmap preview(16, 16);
+    preview.clear(0);
+    options.quality = RenderQuality::Fast;
+    CHECK(document->render(preview, Matrix(), options) == RenderStatus::Completed);
+    CHECK(pixelAt(preview, 3, 8) == 0xffff0000);
+    CHECK(pixelAt(preview, 12, 8) == 0);
+    auto alpha = pixelAt(preview, 7, 8) >> 24;
+    CHECK(alpha > 0 && alpha < 255);
+
+    int progressCount = 0;
+    options.quality = RenderQuality::Normal;
+    options.progressive = true;
+    options.progressCallback = [&](const Bitmap& bitmap) {
+        ++progressCount;
+        CHECK(samePixels(bitmap, preview));
+    };
+
+    Bitmap bitmap(16, 16);
+    bitmap.clear(0);
+    CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::Completed);
+    CHECK(progressCount == 1);
+    CHECK(samePixels(bitmap, expected));
+}
+
+static void testFrameDamage()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='32' height='32'>"
+                                           "<rect id='moving' x='2' y='2' width='4' height='4' fill='#ff0000'/>"
+                                           "<rect x='20' y='20' width='8' height='8' fill='#0000ff'/></svg>");
+    CHECK(document != nullptr);
+    FrameRenderer frames(*document, -1, -1, 0xffffffff);
+    frames.renderFrame();
+    CHECK(frames.stats().damageRect.w == 32 && frames.stats().damageRect.h == 32);
+    CHECK(samePixels(frames.bitmap(), document->renderToBitmap(-1, -1, 0xffffffff)));
+
+    // The damage covers the old and the new position, grown by one pixel for antialiasing.
+    auto moving = document->getElementById("moving");
+    frames.setAttribute(moving, "x", "10");
+    frames.renderFrame();
+    const auto& damageRect = frames.stats().damageRect;
+    CHECK(frames.stats().changedElements == 1 && !frames.stats().fullLayout);
+    CHECK(damageRect.x == 1 && damageRect.y == 1 && damageRect.w == 14 && damageRect.h == 6);
+    CHECK(samePixels(frames.bitmap(), document->renderToBitmap(-1, -1, 0xffffffff)));
+    CHECK(pixelAt(frames.bitmap(), 3, 3) == 0xffffffff);
+    CHECK(pixelAt(frames.bitmap(), 11, 3) == 0xffff0000);
+
+    frames.renderFrame();
+    CHECK(frames.stats().changedElements == 0 && frames.stats().damageRect.w == 0);
+
+    frames.setAttribute(moving, "id", "renamed");
+    frames.renderFrame();
+    CHECK(frames.stats().fullLayout && frames.stats().damageRect.w == 32);
+    CHECK(samePixels(frames.bitmap(), document->renderToBitmap(-1, -1, 0xffffffff)));
+}
+
+static void testTraceExportDuringRender()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='16' height='16'>"
+                                           "<g id='group'><rect width='8' height='8' fill='#ff0000'/></g></svg>");
+    CHECK(document != nullptr);
+    CHECK(document->exportTrace().empty());
+    document->setTracingEnabled(true);
+
+    // Exports run while another thread keeps appending events.
+    std::thread renderer([&]() {
+        Bitmap bitmap(16, 16);
+        for(int index = 0; index < 200; ++index) {
+            document->render(bitmap);
+        }
+    });
+
+    for(int index = 0; index < 50; ++index) {
+        auto trace = document->exportTrace();
+        CHECK(trace.compare(0, 15, "{\"traceEvents\":") == 0);
+    }
+
+    renderer.join();
+    auto trace = document->exportTrace();
+    CHECK(trace.find("\"render svg\"") != std::string::npos);
+    CHECK(trace.find("g#group") != std::string::npos);
+
+    document->clearTrace();
+    CHECK(document->isTracingEnabled());
+    CHECK(document->exportTrace().find("render svg") == std::string::npos);
+}
+
+static void testRenderCost()
+{
+    auto single = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='100' height='100'>"
+                                         "<rect width='10' height='10' fill='#ff0000'/></svg>");
+    CHECK(single != nullptr);
+    auto cost = single->estimateCost();
+    CHECK(cost.pathSegments > 0);
+    CHECK(cost.coveragePixels == 100);
+    CHECK(cost.layers == 0 && cost.totalPixels() == 100);
+    CHECK(single->estimateCost(200, 200).coveragePixels == 400);
+
+    // The off-canvas and hidden rects are skipped the way a render skips them.
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='100' height='100'>"
+                                           "<rect width='10' height='10' fill='#ff0000'/>"
+                                           "<g opacity='0.5'><rect x='50' y='50' width='20' height='20' fill='#00ff00'/></g>"
+                                           "<rect x='200' width='10' height='10' fill='#0000ff'/>"
+                                           "<rect width='10' height='10' fill='#0000ff' display='none'/></svg>");
+    CHECK(document != nullptr);
+    auto total = document->estimateCost();
+    CHECK(total.pathSegments == 2 * cost.pathSegments);
+    CHECK(total.coveragePixels == 500);
+    CHECK(total.layers == 1 && total.layerPixels == 400 && total.peakLayerPixels == 400);
+    CHECK(total.totalPixels() == 900);
+
+    RenderBudget budget;
+    CHECK(total.fits(budget));
+    budget.maxTotalPixels = 900;
+    CHECK(total.fits(budget));
+    budget.maxTotalPixels = 899;
+    CHECK(!total.fits(budget));
+    budget.maxTotalPixels = 0;
+    budget.maxPeakLayerPixels = 399;
+    CHECK(!total.fits(budget));
+    budget.maxPeakLayerPixels = 0;
+    budget.maxPathSegments = total.pathSegments - 1;
+    CHECK(!total.fits(budget));
+}
+
+static void testResourceLimits()
+{
+    const std::string threeElements("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'><g><rect width='8' height='8'/></g></svg>");
+    ResourceLimits limits;
+    limits.maxElements = 3;
+    CHECK(Document::loadFromData(threeElements, limits) != nullptr);
+    limits.maxElements = 2;
+    CHECK(Document::loadFromData(threeElements, limits) == nullptr);
+
+    // Each <use> clones the group and its two rects.
+    const std::string twoUses("<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink' width='8' height='8'>"
+                              "<g id='g'><rect width='4' height='4'/><rect x='4' width='4' height='4'/></g>"
+                              "<use xlink:href='#g'/><use xlink:href='#g' y='4'/></svg>");
+    limits = ResourceLimits();
+    limits.maxUseExpansion = 6;
+    CHECK(Document::loadFromData(twoUses, limits) != nullptr);
+    limits.maxUseExpansion = 5;
+    CHECK(Document::loadFromData(twoUses, limits) == nullptr);
+
+    limits = ResourceLimits();
+    auto document = Document::loadFromData(twoUses, limits);
+    CHECK(document != nullptr);
+    auto segments = document->estimateCost().pathSegments;
+    limits.maxPathSegments = segments;
+    document = Document::loadFromData(twoUses, limits);
+    Bitmap bitmap(8, 8);
+    CHECK(document->render(bitmap, Matrix(), RenderOptions()) == RenderStatus::Completed);
+    limits.maxPathSegments = segments - 1;
+    document = Document::loadFromData(twoUses, limits);
+    CHECK(document->render(bitmap, Matrix(), RenderOptions()) == RenderStatus::LimitExceeded);
+
+    limits = ResourceLimits();
+    limits.maxLayerSize = 7;
+    document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                      "<rect width='8' height='8' fill='#ff0000' opacity='0.5'/></svg>", limits);
+    CHECK(document->render(bitmap, Matrix(), RenderOptions()) == RenderStatus::LimitExceeded);
+
+    // A cancelled token stops the render before anything is drawn.
+    CancellationToken token;
+    token.cancel();
+    RenderOptions options;
+    options.cancellationToken = &token;
+    document = Document::loadFromData(twoUses);
+    bitmap.clear(0);
+    CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::Cancelled);
+    CHECK(pixelAt(bitmap, 2, 2) == 0);
+    token.reset();
+    CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::Completed);
+    CHECK(pixelAt(bitmap, 2, 2) == 0xff000000);
+}
+
+static void testRenderTimeouts()
+{
+    std::string content("<svg xmlns='http://www.w3.org/2000/svg' width='16' height='16'>");
+    for(int index = 0; index < 2000; ++index)
+        content += "<rect width='16' height='16' fill='#ff0000'/>";
+    content += "</svg>";
+    auto document = Document::loadFromData(content);
+    CHECK(document != nullptr);
+
+    Bitmap bitmap(16, 16);
+    RenderOptions options;
+    options.timeout = 1e-6;
+    CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::TimedOut);
+    options.timeout = 0;
+    CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::Completed);
+
+    ResourceLimits limits;
+    limits.maxRenderTime = 1e-6;
+    document = Document::loadFromData(content, limits);
+    CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::TimedOut);
+
+    // When the full-quality pass stops early, the coarse pass stays in the bitmap.
+    document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='16' height='16'>"
+                                      "<rect width='8' height='16' fill='#ff0000'/></svg>");
+    CancellationToken token;
+    Bitmap preview(16, 16);
+    options.progressive = true;
+    options.cancellationToken = &token;
+    options.progressCallback = [&](const Bitmap& bitmap) {
+        for(int y = 0; y < bitmap.height(); ++y)
+            std::memcpy(preview.data() + y * preview.stride(), bitmap.data() + y * bitmap.stride(), bitmap.width() * 4);
+        token.cancel();
+    };
+
+    bitmap.clear(0);
+    CHECK(document->render(bitmap, Matrix(), options) == RenderStatus::Cancelled);
+    CHECK(samePixels(bitmap, preview));
+    CHECK((pixelAt(bitmap, 7, 8) >> 24) < 255);
+}
+
+static void testMemoryUsage()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                           "<rect id='r' class='a b' width='8' height='8' fill='#ff0000'/></svg>");
+    CHECK(document != nullptr);
+    auto usage = document->memoryUsage();
+    CHECK(usage.nodes > 0 && usage.attributes > 0 && usage.paths > 0 && usage.idCache > 0);
+    CHECK(usage.images == 0 && usage.text == 0 && usage.useClones == 0);
+    CHECK(usage.total() == usage.nodes + usage.attributes + usage.paths + usage.properties + usage.idCache);
+
+    // Clones made by <use> are reported separately and leave the other categories unchanged.
+    auto withUse = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' xmlns:xlink='http://www.w3.org/1999/xlink' width='8' height='8'>"
+                                          "<rect id='r' class='a b' width='8' height='8' fill='#ff0000'/><use xlink:href='#r'/></svg>");
+    CHECK(withUse != nullptr);
+    auto useUsage = withUse->memoryUsage();
+    CHECK(useUsage.useClones > 0);
+    CHECK(useUsage.paths == usage.paths);
+
+    auto withText = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'><text>hello</text></svg>");
+    CHECK(withText != nullptr);
+    CHECK(withText->memoryUsage().text > 0);
+
+    Bitmap pixels(4, 4);
+    pixels.clear(0xff0000ff);
+    std::string png;
+    CHECK(pixels.writeToPng(appendBytes, &png, PngOptions()));
+    auto withImage = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'>"
+                                            "<image width='4' height='4' href='data:image/png;base64," + encodeBase64(png) + "'/></svg>");
+    CHECK(withImage != nullptr);
+    CHECK(withImage->memoryUsage().images >= 4 * 4 * 4);
+}
+
+static void testDocumentCache()
+{
+    DocumentCache cache;
+    const std::string red("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'><rect width='8' height='8' fill='#ff0000'/></svg>");
+    const std::string blue("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'><rect width='8' height='8' fill='#0000ff'/></svg>");
+    auto first = cache.loadFromData(red);
+    auto second = cache.loadFromData(std::string(red));
+    CHECK(first != nullptr && first == second);
+    CHECK(cache.stats().hits == 1 && cache.stats().misses == 1);
+    CHECK(cache.stats().bytes >= red.size());
+
+    // Same length, different bytes: never served from the other entry.
+    auto third = cache.loadFromData(blue);
+    CHECK(third != nullptr && third != first);
+    CHECK(pixelAt(third->renderToBitmap(), 4, 4) == 0xff0000ff);
+    CHECK(pixelAt(first->renderToBitmap(), 4, 4) == 0xffff0000);
+    CHECK(cache.stats().documents == 2);
+
+    // Text cannot be rendered from several threads, so each load gets its own document.
+    const std::string text("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'><text>x</text></svg>");
+    auto fourth = cache.loadFromData(text);
+    auto fifth = cache.loadFromData(text);
+    CHECK(fourth != nullptr && fifth != nullptr && fourth != fifth);
+    CHECK(cache.stats().documents == 2);
+}
+
+static void testRenderCacheIdentity()
+{
+    const std::string content("<svg xmlns='http://www.w3.org/2000/svg' width='8' height='8'><rect id='r' width='8' height='8' fill='#ff0000'/></svg>");
+    auto first = Document::loadFromData(content);
+    auto second = Document::loadFromData(content);
+    CHECK(first != nullptr && second != nullptr);
+
+    // Identical sources still get separate entries, so a later change to one never leaks into the other.
+    RenderCache cache;
+    first->renderToBitmap(cache);
+    second->renderToBitmap(cache);
+    CHECK(cache.stats().hits == 0 && cache.stats().entries == 2);
+    second->getElementById("r").setAttribute("fill", "#0000ff");
+    second->updateLayout();
+    CHECK(pixelAt(first->renderToBitmap(cache), 4, 4) == 0xffff0000);
+    CHECK(pixelAt(second->renderToBitmap(cache), 4, 4) == 0xff0000ff);
+    CHECK(cache.stats().hits == 1);
+    CHECK(pixelAt(second->renderToBitmap(cache), 4, 4) == 0xff0000ff);
+    CHECK(cache.stats().hits == 2);
+
+    // Laying the document out again may reload images and fonts, so it starts a new version.
+    second->updateLayout();
+    second->renderToBitmap(cache);
+    CHECK(cache.stats().hits == 2);
+    second->renderToBitmap(cache);
+    CHECK(cache.stats().hits == 3);
+}
+
+static void collectIds(const Element& element, std::string& ids)
+{
+    ids += element.getAttribute("id");
+    for(const auto& child : element.children()) {
+        if(child.isElement()) {
+            collectIds(child.toElement(), ids);
+        }
+    }
+}
+
+static void testChildIteration()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' id='a'>"
+                                           "<g id='b'><rect id='c'/><g id='d'><circle id='e'/></g><text id='f'>t</text></g>"
+                                           "<g id='g'/><path id='h'/></svg>");
+    CHECK(document != nullptr);
+
+    // Range-for follows the sibling links and visits the same nodes as children().
+    auto group = document->getElementById("b");
+    auto children = group.children();
+    size_t index = 0;
+    for(const auto& child : group.childNodes()) {
+        CHECK(index < children.size() && child == children[index]);
+        ++index;
+    }
+
+    CHECK(index == children.size() && index == 3);
+    CHECK(group.firstChild() == children.front() && group.lastChild() == children.back());
+    CHECK(children.back().previousSibling() == children[1] && children.front().previousSibling().isNull());
+    CHECK(document->getElementById("g").childNodes().empty());
+    CHECK(document->getElementById("g").firstChild().isNull());
+
+    std::string expected;
+    collectIds(document->documentElement(), expected);
+    std::string visited;
+    int textNodes = 0;
+    document->traverse([&](const Node& node) {
+        if(node.isElement())
+            visited += node.toElement().getAttribute("id");
+        textNodes += node.isTextNode();
+        return true;
+    });
+
+    CHECK(visited == expected && visited == "abcdefgh");
+    CHECK(textNodes == 1);
+
+    // Returning false skips the descendants of that node only.
+    visited.clear();
+    document->traverse([&](const Node& node) {
+        if(!node.isElement())
+            return true;
+        auto id = node.toElement().getAttribute("id");
+        visited += id;
+        return id != "b";
+    });
+
+    CHECK(visited == "abgh");
+}
+
+static std::string queryIds(const Document& document, const std::string& selector)
+{
+    std::string ids;
+    for(const auto& element : document.querySelectorAll(selector)) {
+        if(!ids.empty())
+            ids += ' ';
+        ids += element.getAttribute("id");
+    }
+
+    return ids;
+}
+
+static void testSiblingSelectors()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg'><g>"
+                                           "<circle id='c1'/>text<rect id='r1'/><rect id='r2'/><circle id='c2'/><rect id='r3'/>"
+                                           "</g></svg>");
+    CHECK(document != nullptr);
+    CHECK(queryIds(*document, "rect:first-of-type") == "r1");
+    CHECK(queryIds(*document, "rect:last-of-type") == "r3");
+    CHECK(queryIds(*document, "circle:first-of-type") == "c1");
+    CHECK(queryIds(*document, "circle:last-of-type") == "c2");
+    CHECK(queryIds(*document, "g > :first-child") == "c1");
+    CHECK(queryIds(*document, "g > :last-child") == "r3");
+    CHECK(queryIds(*document, "rect:first-child").empty());
+    CHECK(queryIds(*document, "circle + rect") == "r1 r3");
+    CHECK(queryIds(*document, "circle ~ rect") == "r1 r2 r3");
+    CHECK(queryIds(*document, "rect + rect") == "r2");
+    CHECK(queryIds(*document, "rect ~ circle") == "c2");
+}
+
+static void testQuerySelectors()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' id='root'>"
+                                           "<g id='roads' class='layer'><path id='p1' class='road major'/><path id='p2' class='river'/>"
+                                           "<g id='inner'><path id='p3' class='road'/></g></g>"
+                                           "<path id='p4' class='road' stroke='red'/></svg>");
+    CHECK(document != nullptr);
+    CHECK(queryIds(*document, ".road") == "p1 p3 p4");
+    CHECK(queryIds(*document, "g > path.road") == "p1 p3");
+    CHECK(queryIds(*document, "#roads path") == "p1 p2 p3");
+    CHECK(queryIds(*document, "path.road.major, #p2") == "p1 p2");
+    CHECK(queryIds(*document, "[stroke=red]") == "p4");
+    CHECK(queryIds(*document, "svg") == "root");
+    CHECK(queryIds(*document, "*").size() == std::string("root roads p1 p2 inner p3 p4").size());
+    CHECK(queryIds(*document, "path[").empty());
+    CHECK(document->querySelector(".road").getAttribute("id") == "p1");
+    CHECK(document->querySelector(".missing").isNull());
+    CHECK(document->querySelector("path[").isNull());
+
+    // Element queries only look at descendants, never the element itself.
+    auto roads = document->getElementById("roads");
+    CHECK(roads.querySelectorAll(".road").size() == 2);
+    CHECK(roads.querySelectorAll(".layer").empty());
+    CHECK(roads.querySelector("g path").getAttribute("id") == "p1");
+
+    // The list form appends, so one list can be reused across queries.
+    ElementList elements;
+    CHECK(document->querySelectorAll(".road", elements) == 3);
+    CHECK(roads.querySelectorAll(".river", elements) == 1);
+    CHECK(elements.size() == 4 && elements.back().getAttribute("id") == "p2");
+}
+
+static void testClassIndex()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg'>"
+                                           "<defs><rect id='r1' class='a b' width='4' height='4'/></defs>"
+                                           "<rect id='r2' class=' b\t\na  a '/><rect id='r3'/>"
+                                           "<use id='u1' href='#r1'/></svg>");
+    CHECK(document != nullptr);
+    CHECK(queryIds(*document, ".a") == "r1 r2");
+    CHECK(queryIds(*document, ".b") == "r1 r2");
+    CHECK(queryIds(*document, ".a.b") == "r1 r2");
+
+    // Elements cloned by <use> never show up, even after a layout has built them.
+    document->updateLayout();
+    CHECK(queryIds(*document, ".a") == "r1 r2");
+    CHECK(queryIds(*document, "use .a").empty());
+
+    // Adding a token to a later element keeps document order; removing one drops it.
+    auto r3 = document->getElementById("r3");
+    r3.setAttribute("class", "c a");
+    CHECK(queryIds(*document, ".a") == "r1 r2 r3");
+    CHECK(queryIds(*document, ".c") == "r3");
+    document->getElementById("r1").setAttribute("class", "b");
+    CHECK(queryIds(*document, ".a") == "r2 r3");
+    CHECK(queryIds(*document, ".b") == "r1 r2");
+    r3.setAttribute("class", "");
+    CHECK(queryIds(*document, ".a") == "r2");
+    CHECK(queryIds(*document, ".c").empty());
+    document->getElementById("r1").setAttribute("class", "a");
+    CHECK(queryIds(*document, ".a") == "r1 r2");
+}
+
+static void testHrefTargetsFollowIds()
+{
+    auto document = Document::loadFromData("<svg xmlns='http://www.w3.org/2000/svg' width='4' height='4'>"
+                                           "<linearGradient id='paint' href='#stops'/>"
+                                           "<linearGradient id='red'><stop stop-color='#ff0000'/></linearGradient>"
+                                           "<linearGradient id='blue'><stop stop-color='#0000ff'/></linearGradient>"
+                                           "<rect width='4' height='4' fill='url(#paint)'/></svg>");
+    CHECK(document != nullptr);
+    CHECK(pixelAt(document->renderToBitmap(), 1, 1) == 0);
+
+    // Adding the id the href names makes the gradient inherit its stops.
+    auto red = document->getElementById("red");
+    red.setAttribute("id", "stops");
+    document->updateLayout();
+    CHECK(document->getElementById("red").isNull());
+    CHECK(document->getElementById("stops") == red);
+    CHECK(pixelAt(document->renderToBitmap(), 1, 1) == 0xffff0000);
+
+    // Renaming a later element onto a taken id leaves the first one in document order in place.
+    auto blue = document->getElementById("blue");
+    blue.setAttribute("id", "stops");
+    document->updateLayout();
+    CHECK(document->getElementById("stops") == red);
+    CHECK(pixelAt(document->renderToBitmap(), 1, 1) == 0xffff0000);
+
+    // Renaming the owner away hands the id to the next element that carries it.
+    red.setAttribute("id", "red");
+    document->updateLayout();
+    CHECK(document->getElementById("stops") == blue);
+    CHECK(pixelAt(document->renderToBitmap(), 1, 1) == 0xff0000ff);
+
+    // Removing the last holder leaves the href dangling again.
+    blue.setAttribute("id", "");
+    document->updateLayout();
+    CHECK(document->getElementById("stops").isNull());
+    CHECK(pixelAt(document->renderToBitmap(), 1, 1) == 0);
+}
+
+int main()
+{
+    testFrameThroughRenderCache();
+    testLayerLimits();
+    testDuplicateIdQueries();
+    testPartialBackgroundClears();
+    testPngThreadCount();
+    testBandedRenderTargets();
+    testPngRoundTrip();
+    testImageEncoders();
+    testBandedPngStream();
+    testBatchRender();
+    testPooledElementRender();
+    testAbortedOpaqueRender();
+    testTiles();
+    testRenderQuality();
+    testFrameDamage();
+    testTraceExportDuringRender();
+    testRenderCost();
+    testResourceLimits();
+    testRenderTimeouts();
+    testMemoryUsage();
+    testDocumentCache();
+    testRenderCacheIdentity();
+    testChildIteration();
+    testSiblingSelectors();
+    testQuerySelectors();
+    testClassIndex();
+    testHrefTargetsFollowIds();
+    if(failureCount > 0) {
+        std::fprintf(stderr, "%d checks failed\n", failureCount);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}